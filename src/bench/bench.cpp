@@ -0,0 +1,626 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../core/Mari.hpp"
+#include "../core/intc.hpp"
+#include "../core/scheduler.hpp"
+#include "../core/bus/bus.hpp"
+#include "../core/cpu/cpu.hpp"
+#include "../core/cpu/gte.hpp"
+#include "../core/gpu/gpu.hpp"
+#include "../core/simd/simd.hpp"
+#include "../core/spu/spu.hpp"
+#include "../core/timer/timer.hpp"
+
+namespace ps {
+
+/* Called by the GPU at VBLANK, never reached since the scheduler doesn't run */
+void update(const u8 *fb) {
+    (void)fb;
+}
+
+}
+
+namespace ps::bench {
+
+using Clock = std::chrono::steady_clock;
+
+/* --- Benchmark constants --- */
+
+constexpr double MIN_RUN_TIME = 0.02; // Minimum time per repetition (seconds)
+
+constexpr u64 MAX_SPU_SAMPLES = 1 << 18; // Keeps voices inside of SPU RAM
+
+/* Microbenchmark */
+struct Benchmark {
+    const char *name;
+
+    u64 pixelsPerOp; // 0 if not a drawing benchmark
+    u64 maxOps;      // 0 if unlimited
+
+    std::function<void()> prepare; // Untimed, runs before every repetition
+    std::function<void(u64)> run;  // Runs n operations
+};
+
+/* Benchmark statistics (ns/op) */
+struct Result {
+    double median, min, stddev;
+};
+
+std::vector<Benchmark> benchmarks;
+
+volatile u32 sink; // Keeps results of bus reads alive
+
+/* Runs a function with stdout discarded, register writes are logged by some modules */
+void quiet(const std::function<void()> &func) {
+    std::fflush(stdout);
+
+    const auto out = dup(STDOUT_FILENO);
+    const auto null = open("/dev/null", O_WRONLY);
+
+    dup2(null, STDOUT_FILENO);
+    close(null);
+
+    func();
+
+    std::fflush(stdout);
+
+    dup2(out, STDOUT_FILENO);
+    close(out);
+}
+
+/* Returns elapsed time of n operations in seconds */
+double measure(const Benchmark &b, u64 n) {
+    if (b.prepare) b.prepare();
+
+    const auto start = Clock::now();
+
+    b.run(n);
+
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+Result runBenchmark(const Benchmark &b, int reps) {
+    /* Find number of operations per repetition */
+    u64 n = 1;
+
+    while (measure(b, n) < MIN_RUN_TIME) {
+        if (b.maxOps && (2 * n > b.maxOps)) break;
+
+        n *= 2;
+    }
+
+    std::vector<double> times;
+
+    for (int i = 0; i < reps; i++) times.push_back(1E9 * measure(b, n) / n);
+
+    std::sort(times.begin(), times.end());
+
+    double mean = 0.0, var = 0.0;
+
+    for (auto t : times) mean += t;
+
+    mean /= reps;
+
+    for (auto t : times) var += (t - mean) * (t - mean);
+
+    return Result{times[reps / 2], times[0], std::sqrt(var / reps)};
+}
+
+void add(const char *name, u64 pixelsPerOp, std::function<void(u64)> run, std::function<void()> prepare = nullptr, u64 maxOps = 0) {
+    benchmarks.push_back(Benchmark{name, pixelsPerOp, maxOps, prepare, run});
+}
+
+/* --- GPU benchmarks --- */
+
+/* Packs GPU coordinates */
+constexpr u32 xy(u32 x, u32 y) {
+    return (y << 16) | x;
+}
+
+void addGPU() {
+    static const u32 triSizes[] = { 8, 32, 128 };
+    static const char *flatNames[] = { "gpu/flat_tri_8", "gpu/flat_tri_32", "gpu/flat_tri_128" };
+    static const char *shadedNames[] = { "gpu/shaded_tri_8", "gpu/shaded_tri_32", "gpu/shaded_tri_128" };
+    static const char *texturedNames[] = { "gpu/textured_tri_8", "gpu/textured_tri_32", "gpu/textured_tri_128" };
+
+    /* Right triangles, roughly size * size / 2 pixels */
+    for (int i = 0; i < 3; i++) {
+        const auto s = triSizes[i];
+
+        add(flatNames[i], s * s / 2, [s](u64 n) {
+            for (u64 j = 0; j < n; j++) {
+                gpu::writeGP0(0x20808080);
+                gpu::writeGP0(xy(0, 0));
+                gpu::writeGP0(xy(s, 0));
+                gpu::writeGP0(xy(0, s));
+            }
+        });
+
+        add(shadedNames[i], s * s / 2, [s](u64 n) {
+            for (u64 j = 0; j < n; j++) {
+                gpu::writeGP0(0x300000FF);
+                gpu::writeGP0(xy(0, 0));
+                gpu::writeGP0(0x0000FF00);
+                gpu::writeGP0(xy(s, 0));
+                gpu::writeGP0(0x00FF0000);
+                gpu::writeGP0(xy(0, s));
+            }
+        });
+
+        /* 4-bit texture at (512, 0), CLUT at (0, 480) */
+        add(texturedNames[i], s * s / 2, [s](u64 n) {
+            const u32 clut = (480 << 6) | 0;
+            const u32 page = 8;
+
+            for (u64 j = 0; j < n; j++) {
+                gpu::writeGP0(0x24808080);
+                gpu::writeGP0(xy(0, 0));
+                gpu::writeGP0((clut << 16) | 0x0000);
+                gpu::writeGP0(xy(s, 0));
+                gpu::writeGP0((page << 16) | (s - 1));
+                gpu::writeGP0(xy(0, s));
+                gpu::writeGP0((s - 1) << 8);
+            }
+        });
+    }
+
+    add("gpu/fill_64x64", 64 * 64, [](u64 n) {
+        for (u64 j = 0; j < n; j++) {
+            gpu::writeGP0(0x02204060);
+            gpu::writeGP0(xy(0, 0));
+            gpu::writeGP0(xy(4, 4)); // In 16px units
+        }
+    });
+
+    add("gpu/flat_rect_64x64", 64 * 64, [](u64 n) {
+        for (u64 j = 0; j < n; j++) {
+            gpu::writeGP0(0x60808080);
+            gpu::writeGP0(xy(0, 0));
+            gpu::writeGP0(xy(64, 64));
+        }
+    });
+
+    /* Copies start at line 0, the copy code ignores the start line for the end line */
+    add("gpu/copy_cpu_to_vram_64x64", 64 * 64, [](u64 n) {
+        for (u64 j = 0; j < n; j++) {
+            gpu::writeGP0(0xA0000000);
+            gpu::writeGP0(xy(0, 0));
+            gpu::writeGP0(xy(64, 64));
+
+            for (u32 k = 0; k < (64 * 64 / 2); k++) gpu::writeGP0(k * 0x00010001);
+        }
+    });
+
+    add("gpu/copy_vram_to_vram_64x64", 64 * 64, [](u64 n) {
+        for (u64 j = 0; j < n; j++) {
+            gpu::writeGP0(0x80000000);
+            gpu::writeGP0(xy(0, 0));
+            gpu::writeGP0(xy(512, 0));
+            gpu::writeGP0(xy(64, 64));
+        }
+    });
+
+    add("gpu/copy_vram_to_cpu_64x64", 64 * 64, [](u64 n) {
+        for (u64 j = 0; j < n; j++) {
+            gpu::writeGP0(0xC0000000);
+            gpu::writeGP0(xy(0, 0));
+            gpu::writeGP0(xy(64, 64));
+
+            for (u32 k = 0; k < (64 * 64 / 2); k++) sink = gpu::readGPUREAD();
+        }
+    });
+}
+
+/* Checks that gpu/fill_64x64 fills exactly 64x64 pixels, returns false on failure */
+bool checkFill() {
+    constexpr u32 SIZE = 128; // Checked area
+
+    /* Clear checked area */
+    gpu::writeGP0(0x02000000);
+    gpu::writeGP0(xy(0, 0));
+    gpu::writeGP0(xy(SIZE / 16, SIZE / 16));
+
+    gpu::writeGP0(0x02204060);
+    gpu::writeGP0(xy(0, 0));
+    gpu::writeGP0(xy(4, 4));
+
+    gpu::writeGP0(0xC0000000);
+    gpu::writeGP0(xy(0, 0));
+    gpu::writeGP0(xy(SIZE, SIZE));
+
+    u32 filled = 0, outside = 0;
+
+    for (u32 i = 0; i < (SIZE * SIZE); i += 2) {
+        const auto data = gpu::readGPUREAD();
+
+        for (u32 j = 0; j < 2; j++) {
+            if (!((data >> (16 * j)) & 0xFFFF)) continue;
+
+            const auto x = (i + j) % SIZE;
+            const auto y = (i + j) / SIZE;
+
+            if ((x < 64) && (y < 64)) {
+                filled++;
+            } else {
+                outside++;
+            }
+        }
+    }
+
+    if ((filled != (64 * 64)) || outside) {
+        std::printf("[Bench     ] gpu/fill_64x64 check failed: %u pixels filled, %u outside of 64x64\n", filled, outside);
+
+        return false;
+    }
+
+    return true;
+}
+
+/* Sets up drawing area, offset and texture data, returns false if a check fails */
+bool initGPU() {
+    gpu::writeGP0(0xE1000000);
+    gpu::writeGP0(0xE2000000);
+    gpu::writeGP0(0xE3000000);
+    gpu::writeGP0(0xE4000000 | (511 << 10) | 1023);
+    gpu::writeGP0(0xE5000000);
+
+    if (!checkFill()) return false;
+
+    /* Fill VRAM with a deterministic pattern (texture pages, CLUTs) */
+    gpu::writeGP0(0xA0000000);
+    gpu::writeGP0(xy(0, 0));
+    gpu::writeGP0(xy(1024, 512));
+
+    u32 seed = 0x12345678;
+
+    for (u32 i = 0; i < (1024 * 512 / 2); i++) {
+        seed = 1664525 * seed + 1013904223;
+
+        gpu::writeGP0(seed);
+    }
+
+    return true;
+}
+
+/* --- GTE benchmarks --- */
+
+struct GTEOp {
+    const char *name;
+
+    u32 cmd;
+};
+
+void addGTE() {
+    static const GTEOp ops[] = {
+        { "gte/rtps" , 0x0180001 },
+        { "gte/rtpt" , 0x0280030 },
+        { "gte/nclip", 0x1400006 },
+        { "gte/mvmva", 0x0480012 },
+        { "gte/ncds" , 0x0E80413 },
+        { "gte/ncct" , 0x0F8043F },
+        { "gte/sqr"  , 0x0A80428 },
+        { "gte/avsz3", 0x158002D },
+        { "gte/avsz4", 0x168002E },
+        { "gte/gpf"  , 0x198003D },
+        { "gte/gpl"  , 0x1A8003E },
+    };
+
+    for (auto &op : ops) {
+        const auto cmd = op.cmd;
+
+        add(op.name, 0, [cmd](u64 n) {
+            for (u64 j = 0; j < n; j++) cpu::gte::doCmd(cmd);
+        }, [] {
+            /* Reload inputs, some commands overwrite them */
+            cpu::gte::set(0x00, (0x0100 << 16) | 0xFF00); // VXY0
+            cpu::gte::set(0x01, 0x0400);                  // VZ0
+            cpu::gte::set(0x02, (0xFF00 << 16) | 0x0100); // VXY1
+            cpu::gte::set(0x03, 0x0500);                  // VZ1
+            cpu::gte::set(0x04, (0x0080 << 16) | 0x0080); // VXY2
+            cpu::gte::set(0x05, 0x0600);                  // VZ2
+            cpu::gte::set(0x06, 0x20808080);              // RGBC
+            cpu::gte::set(0x08, 0x0800);                  // IR0
+            cpu::gte::set(0x09, 0x0400);                  // IR1
+            cpu::gte::set(0x0A, 0x0800);                  // IR2
+            cpu::gte::set(0x0B, 0x0C00);                  // IR3
+
+            /* Fill the screen FIFOs */
+            cpu::gte::doCmd(0x0280030);
+        });
+    }
+}
+
+void initGTE() {
+    /* Slightly rotated matrices (4.12 fixed point) */
+    cpu::gte::setControl(0x00, (0x0100 << 16) | 0x0F00); // RT11RT12
+    cpu::gte::setControl(0x01, (0xFF00 << 16) | 0x0000); // RT13RT21
+    cpu::gte::setControl(0x02, (0x0000 << 16) | 0x0F00); // RT22RT23
+    cpu::gte::setControl(0x03, 0);                       // RT31RT32
+    cpu::gte::setControl(0x04, 0x1000);                  // RT33
+    cpu::gte::setControl(0x05, 0x10);                    // TRX
+    cpu::gte::setControl(0x06, 0x20);                    // TRY
+    cpu::gte::setControl(0x07, 0x400);                   // TRZ
+
+    for (u32 i = 0x08; i <= 0x0C; i++) cpu::gte::setControl(i, 0x08000800); // Light source matrix
+    for (u32 i = 0x0D; i <= 0x0F; i++) cpu::gte::setControl(i, 0x100);      // Background color
+    for (u32 i = 0x10; i <= 0x14; i++) cpu::gte::setControl(i, 0x04000400); // Light color matrix
+    for (u32 i = 0x15; i <= 0x17; i++) cpu::gte::setControl(i, 0x800);      // Far color
+
+    cpu::gte::setControl(0x18, 160 << 16); // OFX
+    cpu::gte::setControl(0x19, 120 << 16); // OFY
+    cpu::gte::setControl(0x1A, 200);       // H
+    cpu::gte::setControl(0x1B, 0xFFFF);    // DCA
+    cpu::gte::setControl(0x1C, 0x100000);  // DCB
+    cpu::gte::setControl(0x1D, 0x155);     // ZSF3
+    cpu::gte::setControl(0x1E, 0x100);     // ZSF4
+}
+
+/* --- SPU benchmarks --- */
+
+/* Keys on the first voiceCount voices, each voice gets its own part of SPU RAM */
+void keyOn(int voiceCount) {
+    const u32 voiceMask = (voiceCount == 24) ? 0xFFFFFF : (1 << voiceCount) - 1;
+
+    quiet([voiceMask] {
+        spu::write(0x1F801D8C, 0xFFFF); // KOFF
+        spu::write(0x1F801D8E, 0xFF);
+
+        for (int i = 0; i < 24; i++) {
+            const u32 base = 0x1F801C00 + 16 * i;
+
+            spu::write(base + 0x0, 0x3FFF);               // VOLL
+            spu::write(base + 0x2, 0x3FFF);               // VOLR
+            spu::write(base + 0x4, 0x1000 + 0x80 * i);    // PITCH
+            spu::write(base + 0x6, 0x0200 + 0x0040 * i);  // ADDR (8-byte units)
+            spu::write(base + 0x8, 0x000F);               // ADSR_LO, fast attack
+            spu::write(base + 0xA, 0x1F00 | (1 << 14));   // ADSR_HI, slow sustain decrease
+            spu::write(base + 0xC, 0);                    // ADSRVOL
+        }
+
+        spu::write(0x1F801D88, voiceMask); // KON
+        spu::write(0x1F801D8A, voiceMask >> 16);
+    });
+}
+
+void addSPU() {
+    add("spu/mix_1_voice", 0, [](u64 n) {
+        for (u64 j = 0; j < n; j++) spu::step();
+    }, [] { keyOn(1); }, MAX_SPU_SAMPLES);
+
+    add("spu/mix_24_voices", 0, [](u64 n) {
+        for (u64 j = 0; j < n; j++) spu::step();
+    }, [] { keyOn(24); }, MAX_SPU_SAMPLES);
+}
+
+/* Fills SPU RAM with ADPCM blocks, sets up volume */
+void initSPU() {
+    quiet([] {
+        spu::write(0x1F801DAA, 0xC000); // SPUCNT, SPU enabled, unmuted
+        spu::write(0x1F801D80, 0x3FFF); // MVOLL
+        spu::write(0x1F801D82, 0x3FFF); // MVOLR
+        spu::write(0x1F801DA6, 0);      // SPUADDR
+    });
+
+    u32 seed = 0x87654321;
+
+    /* 16-byte blocks: shift/filter, flags (always 0), 14 bytes of samples */
+    for (u32 block = 0; block < (0x80000 / 16); block++) {
+        const u16 header = ((block % 5) << 4) | (block % 13);
+
+        spu::write(0x1F801DA8, header);
+
+        for (int i = 0; i < 7; i++) {
+            seed = 1664525 * seed + 1013904223;
+
+            spu::write(0x1F801DA8, seed >> 16);
+        }
+    }
+}
+
+/* --- CPU checks --- */
+
+/* A block that ends with a load in a branch delay slot, the next block overwrites the loaded register */
+constexpr u32 loadDelayProgram[] = {
+    0x3C028000, // LUI   $2, 0x8000
+    0x34031234, // ORI   $3, $0, 0x1234
+    0xAC430100, // SW    $3, 0x100($2)
+    0x34040007, // ORI   $4, $0, 7
+    0x08000408, // J     0x80001020
+    0x8C410100, // LW    $1, 0x100($2)
+    0x00000000, // NOP
+    0x00000000, // NOP
+    0x00840821, // ADDU  $1, $4, $4 (cancels the pending load)
+    0x00202821, // ADDU  $5, $1, $0
+    0x0800040A, // J     0x80001028
+    0x00000000, // NOP
+};
+
+/* Runs the load delay program on a CPU core, returns $1 and $5 */
+std::pair<u32, u32> runLoadDelay(const char *core) {
+    quiet([core] { cpu::init(core); });
+
+    for (u32 i = 0; i < std::size(loadDelayProgram); i++) bus::write32(0x1000 + 4 * i, loadDelayProgram[i]);
+
+    cpu::pc  = 0x80001000;
+    cpu::npc = 0x80001004;
+
+    cpu::step(1000);
+
+    return {cpu::regs[1], cpu::regs[5]};
+}
+
+/* Checks that the recompiler cancels a load from the previous block like the interpreter, returns false on failure */
+bool checkLoadDelay() {
+    const auto expected = runLoadDelay("switch");
+    const auto result   = runLoadDelay("ir");
+
+    if (result != expected) {
+        std::printf("[Bench     ] IR load delay check failed: $1 = 0x%08X, $5 = 0x%08X (interpreter: 0x%08X, 0x%08X)\n", result.first, result.second, expected.first, expected.second);
+
+        return false;
+    }
+
+    return true;
+}
+
+/* --- Bus benchmarks --- */
+
+void addBus() {
+    add("bus/read32_ram", 0, [](u64 n) {
+        u32 sum = 0;
+
+        for (u64 j = 0; j < n; j++) sum += bus::read32(0x1000 + ((j << 2) & 0xFFFF));
+
+        sink = sum;
+    });
+
+    add("bus/read32_spram", 0, [](u64 n) {
+        u32 sum = 0;
+
+        for (u64 j = 0; j < n; j++) sum += bus::read32(0x1F800000 + ((j << 2) & 0x3FF));
+
+        sink = sum;
+    });
+
+    add("bus/read32_bios", 0, [](u64 n) {
+        u32 sum = 0;
+
+        for (u64 j = 0; j < n; j++) sum += bus::read32(0x1FC00000 + ((j << 2) & 0xFFFF));
+
+        sink = sum;
+    });
+
+    add("bus/read32_io_istat", 0, [](u64 n) {
+        u32 sum = 0;
+
+        for (u64 j = 0; j < n; j++) sum += bus::read32(0x1F801070);
+
+        sink = sum;
+    });
+
+    add("bus/read32_io_gpustat", 0, [](u64 n) {
+        u32 sum = 0;
+
+        for (u64 j = 0; j < n; j++) sum += bus::read32(0x1F801814);
+
+        sink = sum;
+    });
+
+    add("bus/write32_ram", 0, [](u64 n) {
+        for (u64 j = 0; j < n; j++) bus::write32(0x1000 + ((j << 2) & 0xFFFF), (u32)j);
+    });
+
+    add("bus/write32_io_imask", 0, [](u64 n) {
+        for (u64 j = 0; j < n; j++) bus::write32(0x1F801074, 0x0D);
+    });
+}
+
+void printUsage() {
+    std::printf("Usage: mari_bench [options] [filter]\n");
+    std::printf("Options:\n");
+    std::printf("  --reps <n>    Repetitions per benchmark (default: 10)\n");
+    std::printf("  --list        List benchmarks\n");
+    std::printf("  --check       Only run the self-checks\n");
+    std::printf("  --simd <l>    Highest SIMD level (scalar, sse4.1, avx2, avx512)\n");
+    std::printf("Only benchmarks whose name contains the filter are run.\n");
+}
+
+}
+
+int main(int argc, char **argv) {
+    using namespace ps;
+
+    int reps = 10;
+    bool list = false, check = false;
+
+    const char *filter = "";
+    const char *simdLevel = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--list")) {
+            list = true;
+        } else if (!std::strcmp(argv[i], "--check")) {
+            check = true;
+        } else if (!std::strcmp(argv[i], "--reps") && ((i + 1) < argc)) {
+            reps = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--simd") && ((i + 1) < argc)) {
+            simdLevel = argv[++i];
+        } else if (std::strncmp(argv[i], "--", 2) != 0) {
+            filter = argv[i];
+        } else {
+            bench::printUsage();
+
+            return -1;
+        }
+    }
+
+    if (reps < 1) {
+        bench::printUsage();
+
+        return -1;
+    }
+
+    simd::init(simdLevel);
+
+    bench::quiet([] {
+        scheduler::init();
+
+        bus::init(NULL, NULL);
+        gpu::init();
+        spu::init();
+        timer::init();
+    });
+
+    if (!bench::initGPU() || !bench::checkLoadDelay()) return -1;
+
+    if (check) return 0;
+
+    bench::initGTE();
+    bench::initSPU();
+
+    bench::addGPU();
+    bench::addGTE();
+    bench::addSPU();
+    bench::addBus();
+
+    if (list) {
+        for (auto &b : bench::benchmarks) std::printf("%s\n", b.name);
+
+        return 0;
+    }
+
+    std::printf("%-28s %12s %12s %10s %12s\n", "Benchmark", "ns/op", "min ns/op", "stddev", "Mpixels/s");
+
+    for (auto &b : bench::benchmarks) {
+        if (!std::strstr(b.name, filter)) continue;
+
+        const auto r = bench::runBenchmark(b, reps);
+
+        std::printf("%-28s %12.1f %12.1f %9.1f%%", b.name, r.median, r.min, 100.0 * r.stddev / r.median);
+
+        if (b.pixelsPerOp) {
+            std::printf(" %12.1f\n", 1E3 * b.pixelsPerOp / r.median);
+        } else {
+            std::printf(" %12s\n", "-");
+        }
+    }
+
+    return 0;
+}
@@ -5,13 +5,72 @@
 
 #include "file.hpp"
 
-#include <fstream>
-#include <iterator>
+#include <array>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 std::vector<u8> loadBinary(const char *path) {
-    std::ifstream file{path, std::ios::binary};
+    auto file = mapFile(path);
+
+    std::vector<u8> data{file.data, file.data + file.size};
+
+    unmapFile(file);
+
+    return data;
+}
+
+MappedFile mapFile(const char *path) {
+    MappedFile file;
+
+    const auto fd = open(path, O_RDONLY);
+
+    if (fd < 0) return file;
+
+    struct stat st;
+
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+        const auto data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+        if (data != MAP_FAILED) {
+            file.data = (const u8 *)data;
+            file.size = st.st_size;
+        }
+    }
+
+    close(fd); // The mapping stays valid
+
+    return file;
+}
+
+void unmapFile(MappedFile &file) {
+    if (file.data) munmap((void *)file.data, file.size);
+
+    file = MappedFile{};
+}
+
+/* Reflected CRC-32 lookup table (polynomial 0xEDB88320) */
+constexpr auto crcTable = [] {
+    std::array<u32, 256> table{};
+
+    for (u32 i = 0; i < 256; i++) {
+        u32 c = i;
+
+        for (int j = 0; j < 8; j++) c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+
+        table[i] = c;
+    }
+
+    return table;
+}();
+
+u32 crc32(const u8 *data, size_t size) {
+    u32 crc = 0xFFFFFFFF;
 
-    file.unsetf(std::ios::skipws);
+    for (size_t i = 0; i < size; i++) crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
 
-    return {std::istream_iterator<u8>{file}, {}};
+    return ~crc;
 }
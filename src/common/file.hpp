@@ -5,9 +5,24 @@
 
 #pragma once
 
+#include <cstddef>
 #include <vector>
 
 #include "types.hpp"
 
+/* Read-only file mapping, pages are shared with other processes mapping the same file */
+struct MappedFile {
+    const u8 *data = NULL;
+
+    size_t size = 0;
+};
+
 /* Reads a binary file into a std::vector */
 std::vector<u8> loadBinary(const char *path);
+
+/* Maps a file read-only, returns an empty mapping on failure */
+MappedFile mapFile(const char *path);
+void unmapFile(MappedFile &file);
+
+/* Returns the CRC-32 (IEEE 802.3) of a buffer */
+u32 crc32(const u8 *data, size_t size);
@@ -5,17 +5,29 @@
 
 #include "Mari.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
+#include <utility>
+#include <vector>
 
 #include <ctype.h>
 
+#include "debugger.hpp"
+#include "movie.hpp"
+#include "pacer.hpp"
+#include "profiler.hpp"
 #include "scheduler.hpp"
+#include "tracer.hpp"
 #include "bus/bus.hpp"
 #include "cdrom/cdrom.hpp"
 #include "cpu/cpu.hpp"
+#include "cpu/hotspot.hpp"
+#include "cpu/tcache.hpp"
 #include "dmac/dmac.hpp"
 #include "gpu/gpu.hpp"
+#include "simd/simd.hpp"
 #include "sio/sio.hpp"
 #include "spu/spu.hpp"
 #include "timer/timer.hpp"
@@ -35,10 +47,77 @@ SDL_Event e;
 
 bool isRunning = true;
 
+u64 frameCounter = 0; // Completed frames
+
+/* Benchmark mode */
+u64 benchFrames = 0;
+
+std::vector<u64> hashFrames;
+
+std::vector<std::pair<u64, u16>> inputScript; // Frame, buttons (sorted by frame)
+size_t inputScriptIdx = 0;
+
+u16 scriptedInput = 0;
+
+u64 instrCount = 0;
+
+/* Loads an input script ("FRAME BUTTONS" per line).
+ * Buttons are a hex mask (same layout as keyboard input), they are held from FRAME on.
+ */
+void loadInputScript(const char *path) {
+    auto file = std::fopen(path, "r");
+
+    if (!file) {
+        std::printf("[Mari      ] Unable to open input script \"%s\"\n", path);
+
+        exit(0);
+    }
+
+    char line[256];
+
+    while (std::fgets(line, sizeof(line), file)) {
+        unsigned long long frame;
+        unsigned int buttons;
+
+        if (line[0] == '#') continue;
+
+        if (std::sscanf(line, "%llu %x", &frame, &buttons) != 2) continue;
+
+        inputScript.emplace_back(frame, (u16)buttons);
+    }
+
+    std::fclose(file);
+
+    std::stable_sort(inputScript.begin(), inputScript.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    std::printf("[Mari      ] Loaded %zu input script entries from \"%s\"\n", inputScript.size(), path);
+}
+
+/* Returns scripted buttons for a frame */
+u16 getScriptedInput(u64 frame) {
+    while ((inputScriptIdx < inputScript.size()) && (inputScript[inputScriptIdx].first <= frame)) {
+        scriptedInput = inputScript[inputScriptIdx++].second;
+    }
+
+    return scriptedInput;
+}
+
+/* Returns 64-bit FNV-1a hash of VRAM */
+u64 hashVRAM(const u8 *fb) {
+    u64 hash = 0xCBF29CE484222325;
+
+    for (int i = 0; i < (2 * 1024 * 512); i++) {
+        hash ^= fb[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
 /* Initializes SDL */
 void initSDL() {
     SDL_Init(SDL_INIT_VIDEO);
-    SDL_SetHint(SDL_HINT_RENDER_VSYNC, "1");
+    SDL_SetHint(SDL_HINT_RENDER_VSYNC, "0"); // Paced by pacer::endFrame()
 
     SDL_CreateWindowAndRenderer(1024, 512, 0, &window, &renderer);
     SDL_SetWindowSize(window, 1024, 512);
@@ -49,42 +128,82 @@ void initSDL() {
     texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_XBGR1555, SDL_TEXTUREACCESS_STREAMING, 1024, 512);
 }
 
-void init(const char *biosPath, const char *isoPath, const char *exePath) {
-    std::printf("BIOS path: \"%s\"\nISO path: \"%s\"\n", biosPath, isoPath);
+void init(const Config &config) {
+    std::printf("BIOS path: \"%s\"\nISO path: \"%s\"\n", config.biosPath, config.isoPath);
+
+    benchFrames = config.benchFrames;
+    hashFrames  = config.hashFrames;
+
+    if (config.inputPath) loadInputScript(config.inputPath);
+
+    movie::init(config);
+
+    /* Hash the last frame if no frames were selected */
+    if (benchFrames && hashFrames.empty()) hashFrames.push_back(benchFrames);
+
+    simd::init(config.simdLevel);
+
+    profiler::init(config.profilePath);
+    tracer::init(config.tracePath);
+
+    cpu::hotspot::init(config.hotspotPath, config.symbolPath);
+    cpu::tcache::init(config.tcachePath);
+
+    /* Before the bus maps its pages */
+    debugger::init(config);
 
     scheduler::init();
 
-    bus::init(biosPath, exePath);
-    cdrom::init(isoPath);
-    cpu::init();
+    bus::init(config.biosPath, config.exePath);
+    cdrom::init(config.isoPath);
+    cpu::init(config.cpuCore);
     dmac::init();
     gpu::init();
     sio::init();
     spu::init();
     timer::init();
 
-    scheduler::flush();
+    if (!benchFrames) {
+        pacer::init(config.speed, config.maxFrameSkip);
+
+        initSDL();
+    }
 
-    initSDL();
+    tracer::begin("frame", "frame", "frame", frameCounter);
 }
 
 void run() {
+    const auto start = std::chrono::steady_clock::now();
+
     while (isRunning) {
         const auto runCycles = scheduler::getRunCycles();
 
+        {
+            PROFILE_SCOPE(profiler::Zone::CPU);
+            PROFILE_CYCLES(profiler::Zone::CPU, runCycles);
+
+            instrCount += cpu::step(runCycles);
+        }
+
         scheduler::processEvents(runCycles);
+    }
 
-        cpu::step(runCycles / 2); // 2 cycles per instruction
+    if (benchFrames) {
+        const auto time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-        timer::step(runCycles);
+        std::printf(
+            "[Bench     ] %llu frames in %.3f s, %.2f fps (%.2fx realtime), %.2f MIPS\n", (unsigned long long)frameCounter,
+            time, frameCounter / time, frameCounter / time / pacer::NTSC_RATE, instrCount / time / 1E6
+        );
 
-        scheduler::flush();
+        return;
     }
 
     SDL_Quit();
 }
 
-void update(const u8 *fb) {
+/* Polls SDL events, returns keyboard input */
+u16 pollInput() {
     const u8 *keyState = SDL_GetKeyboardState(NULL);
 
     u16 input = 0;
@@ -112,11 +231,37 @@ void update(const u8 *fb) {
         default: break;
     }
 
-    sio::setInput(~input);
+    return input;
+}
+
+void update(const u8 *fb) {
+    profiler::endFrame();
+
+    tracer::end("frame", "frame");
+
+    ++frameCounter;
+
+    if (std::find(hashFrames.begin(), hashFrames.end(), frameCounter) != hashFrames.end()) {
+        std::printf("[Bench     ] Frame %llu VRAM hash: %016llX\n", (unsigned long long)frameCounter, (unsigned long long)hashVRAM(fb));
+    }
+
+    if (benchFrames && (frameCounter == benchFrames)) isRunning = false;
+
+    /* Benchmark mode doesn't use SDL at all */
+    u16 input = (benchFrames) ? 0 : pollInput();
+
+    if (!inputScript.empty()) input = getScriptedInput(frameCounter);
+
+    sio::setInput(~movie::getInput(frameCounter, input));
+
+    /* Benchmark mode is unthrottled and never presents */
+    if (!benchFrames && pacer::endFrame()) {
+        SDL_UpdateTexture(texture, nullptr, fb, 2 * 1024);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        SDL_RenderPresent(renderer);
+    }
 
-    SDL_UpdateTexture(texture, nullptr, fb, 2 * 1024);
-    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-    SDL_RenderPresent(renderer);
+    tracer::begin("frame", "frame", "frame", frameCounter);
 }
 
 }
@@ -5,11 +5,48 @@
 
 #pragma once
 
+#include <cstddef>
+#include <vector>
+
 #include "../common/types.hpp"
 
 namespace ps {
 
-void init(const char *biosPath, const char *isoPath, const char *exePath);
+/* Emulator configuration */
+struct Config {
+    const char *biosPath = NULL;
+    const char *isoPath  = NULL;
+    const char *exePath  = NULL;
+
+    const char *profilePath = NULL; // Per-frame profiler output (JSON)
+    const char *tracePath   = NULL; // Chrome trace output (JSON)
+    const char *hotspotPath = NULL; // Guest hot spot report
+    const char *symbolPath  = NULL; // Guest symbol map, used by the hot spot report
+
+    /* Benchmark mode (no video output), runs for a fixed number of frames if not 0 */
+    u64 benchFrames = 0;
+
+    std::vector<u64> hashFrames; // Frames to print VRAM hashes of
+    const char *inputPath = NULL; // Input script
+
+    const char *movieRecordPath = NULL; // Record input movie
+    const char *moviePlayPath   = NULL; // Play back input movie
+
+    const char *speed = NULL; // Frame pacing target (ntsc, pal, <n>x, max), NULL: NTSC
+    int maxFrameSkip = 0; // Maximum consecutive frames that aren't presented when running faster than the display
+
+    const char *cpuCore = NULL; // Interpreter (switch, threaded, ir), NULL: switch
+    const char *tcachePath = NULL; // Persistent translation cache (block recompiler)
+
+    const char *simdLevel = NULL; // Caps SIMD kernels at this level (NULL: best supported by the host)
+
+    /* Debugger (guest addresses) */
+    std::vector<u32> breakpoints;
+    std::vector<u32> readWatchpoints;
+    std::vector<u32> writeWatchpoints;
+};
+
+void init(const Config &config);
 void run();
 
 void update(const u8 *fb);
@@ -0,0 +1,54 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "attr.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace ps::bus::attr {
+
+constexpr int ATTRIBUTE_COUNT = 8;
+
+u8 pages[PAGE_COUNT];
+
+WriteFunc writeFuncs[ATTRIBUTE_COUNT];
+
+void setWriteFunc(Attribute attribute, WriteFunc func) {
+    writeFuncs[std::countr_zero((u8)attribute)] = func;
+}
+
+/* Sets an attribute on the page containing addr */
+void set(Region region, u32 addr, Attribute attribute) {
+    pages[getPage(region, addr)] |= attribute;
+}
+
+void clear(Region region, u32 addr, Attribute attribute) {
+    pages[getPage(region, addr)] &= ~attribute;
+}
+
+/* Calls the callbacks of all attributes of a page */
+void notifyWrite(u32 page, Region region, u32 addr, u32 size) {
+    for (u8 attributes = pages[page]; attributes; attributes &= attributes - 1) {
+        const auto func = writeFuncs[std::countr_zero(attributes)];
+
+        if (func) func(region, addr, size);
+    }
+}
+
+/* Checks a bulk write (DMA, PS-EXE loading), skips pages without attributes */
+void checkWriteRange(Region region, u32 addr, u32 size) {
+    const auto end = addr + size;
+
+    while (addr < end) {
+        const auto pageEnd = std::min((addr | ((1 << PAGE_SHIFT) - 1)) + 1, end);
+
+        checkWrite(region, addr, pageEnd - addr);
+
+        addr = pageEnd;
+    }
+}
+
+}
@@ -0,0 +1,65 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include "../../common/types.hpp"
+
+namespace ps::bus::attr {
+
+/* --- Page attribute constants --- */
+
+constexpr u32 PAGE_SHIFT = 12; // 4 KiB pages
+
+/* Guest memories with page attributes, addresses are offsets into the memory */
+enum class Region {
+    RAM,
+    SPRAM,
+    VRAM, // Byte offset, 2 * (x + 1024 * y)
+};
+
+constexpr u32 REGION_SIZE[] = {0x200000, 0x400, 0x100000};
+
+constexpr u32 REGION_BASE[] = {
+    0,
+    REGION_SIZE[0] >> PAGE_SHIFT,
+    (REGION_SIZE[0] >> PAGE_SHIFT) + 1,
+};
+
+constexpr u32 PAGE_COUNT = REGION_BASE[2] + (REGION_SIZE[2] >> PAGE_SHIFT);
+
+/* Attributes, each one has a write callback */
+enum Attribute : u8 {
+    CODE  = 1 << 0, // Decoded code (self-modifying code detection)
+    WATCH = 1 << 1, // Debugger write watchpoint
+};
+
+/* Called with the part of a write that lies within a page */
+using WriteFunc = void (*)(Region region, u32 addr, u32 size);
+
+extern u8 pages[PAGE_COUNT];
+
+void setWriteFunc(Attribute attribute, WriteFunc func);
+
+void set(Region region, u32 addr, Attribute attribute);
+void clear(Region region, u32 addr, Attribute attribute);
+
+void notifyWrite(u32 page, Region region, u32 addr, u32 size);
+void checkWriteRange(Region region, u32 addr, u32 size);
+
+inline u32 getPage(Region region, u32 addr) {
+    const auto r = static_cast<int>(region);
+
+    return REGION_BASE[r] + ((addr & (REGION_SIZE[r] - 1)) >> PAGE_SHIFT);
+}
+
+/* Checks a store (CPU or DMA), a single load and branch on pages without attributes */
+inline void checkWrite(Region region, u32 addr, u32 size) {
+    const auto page = getPage(region, addr);
+
+    if (pages[page]) notifyWrite(page, region, addr, size);
+}
+
+}
@@ -5,10 +5,17 @@
 
 #include "bus.hpp"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
+#include "attr.hpp"
+#include "../debugger.hpp"
 #include "../intc.hpp"
+#include "../profiler.hpp"
 #include "../cdrom/cdrom.hpp"
+#include "../cpu/icache.hpp"
 #include "../dmac/dmac.hpp"
 #include "../gpu/gpu.hpp"
 #include "../mdec/mdec.hpp"
@@ -24,29 +31,69 @@ namespace ps::bus {
 
 /* Base addresses */
 enum class MemoryBase {
-    RAM   = 0x00000000,
-    SPRAM = 0x1F800000, // Scratchpad RAM
-    SIO   = 0x1F801040, // Serial I/O
-    DMA   = 0x1F801080, // DMA controller
-    Timer = 0x1F801100,
-    SPU   = 0x1F801C00, // Sound processing unit
-    BIOS  = 0x1FC00000,
+    RAM     = 0x00000000,
+    SPRAM   = 0x1F800000, // Scratchpad RAM
+    IO      = 0x1F801000, // I/O register page
+    MemCtrl = 0x1F801000, // Memory control
+    SIO     = 0x1F801040, // Serial I/O
+    RAMSize = 0x1F801060,
+    INTC    = 0x1F801070, // Interrupt controller
+    DMA     = 0x1F801080, // DMA controller
+    Timer   = 0x1F801100,
+    CDROM   = 0x1F801800,
+    GPU     = 0x1F801810,
+    MDEC    = 0x1F801820,
+    SPU     = 0x1F801C00, // Sound processing unit
+    POST    = 0x1F802000, // Expansion region 2 (boot status)
+    BIOS    = 0x1FC00000,
 };
 
 /* Memory sizes */
 enum class MemorySize {
-    RAM   = 0x200000,
-    SPRAM = 0x000400,
-    SIO   = 0x000020,
-    DMA   = 0x000080,
-    Timer = 0x000030,
-    SPU   = 0x000280,
-    BIOS  = 0x080000,
+    RAM     = 0x200000,
+    SPRAM   = 0x000400,
+    IO      = 0x002000,
+    MemCtrl = 0x000024,
+    SIO     = 0x000020,
+    RAMSize = 0x000004,
+    INTC    = 0x000008,
+    DMA     = 0x000080,
+    Timer   = 0x000030,
+    CDROM   = 0x000004,
+    GPU     = 0x000008,
+    MDEC    = 0x000008,
+    SPU     = 0x000280,
+    POST    = 0x001000,
+    BIOS    = 0x080000,
+};
+
+/* Known BIOS images */
+struct BIOSInfo {
+    u32 crc;
+
+    const char *model, *version, *region;
+};
+
+constexpr BIOSInfo knownBIOS[] = {
+    {0x3B601FC8, "SCPH-1000", "1.0", "NTSC-J"},
+    {0x3539DEF6, "SCPH-3000", "1.1", "NTSC-J"},
+    {0x9BB87C4B, "SCPH-1002", "2.0", "PAL"   },
+    {0xBC190209, "SCPH-3500", "2.1", "NTSC-J"},
+    {0x37157331, "SCPH-1001", "2.2", "NTSC-U"},
+    {0xFF3EEB8C, "SCPH-5500", "3.0", "NTSC-J"},
+    {0x8D8CB7E4, "SCPH-5501", "3.0", "NTSC-U"},
+    {0xD786F0B9, "SCPH-5502", "3.0", "PAL"   },
+    {0x502224B6, "SCPH-7001", "4.1", "NTSC-U"},
+    {0x318178BF, "SCPH-7502", "4.1", "PAL"   },
+    {0x171BDCEC, "SCPH-101" , "4.5", "NTSC-U"},
 };
 
 /* --- PlayStation memory --- */
 std::vector<u8> ram;
-std::vector<u8> bios;
+
+const u8 *bios; // Mapped read-only
+
+u8 noBIOS[static_cast<size_t>(MemorySize::BIOS)]; // Used if no BIOS is loaded (benchmarks)
 
 u8 spram[static_cast<size_t>(MemorySize::SPRAM)];
 
@@ -59,148 +106,592 @@ u32 exp3Base = 0x1FA00000, exp3Size; // Base is fixed!!
 char path[256];
 bool enableEXE = false;
 
+/* --- Page table --- */
+
+constexpr u32 PAGE_SHIFT = 12;
+constexpr u32 PAGE_SIZE  = 1 << PAGE_SHIFT;
+constexpr u32 PAGE_COUNT = 0x20000000 >> PAGE_SHIFT;
+
+/* Host memory of directly accessible pages (RAM, BIOS), NULL if accesses take the slow path (I/O, scratchpad, read watchpoints) */
+const u8 *readPages[PAGE_COUNT];
+u8 *writePages[PAGE_COUNT];
+
+u32 getPage(u32 addr) {
+    return (addr >> PAGE_SHIFT) & (PAGE_COUNT - 1);
+}
+
 /* Returns true if address is in range [base;size] */
 bool inRange(u64 addr, u64 base, u64 size) {
     return (addr >= base) && (addr < (base + size));
 }
 
+/* Fills the page table, pages with read watchpoints stay unmapped (stores are observed through page attributes) */
+void mapPages() {
+    for (u32 addr = 0; addr < static_cast<u32>(MemorySize::RAM); addr += PAGE_SIZE) {
+        if (!debugger::isWatched(addr, PAGE_SIZE, false)) readPages[getPage(addr)] = &ram[addr];
+
+        writePages[getPage(addr)] = &ram[addr];
+    }
+
+    for (u32 offset = 0; offset < static_cast<u32>(MemorySize::BIOS); offset += PAGE_SIZE) {
+        readPages[getPage(static_cast<u32>(MemoryBase::BIOS) + offset)] = &bios[offset];
+    }
+}
+
+/* --- I/O registers --- */
+
+/* Handlers of one 32-bit I/O register slot, devices register the widths they implement.
+ * The other widths are filled in with adapters, every access is a single indexed call.
+ */
+struct IORegister {
+    u8  (*read8 )(u32 addr) = NULL;
+    u16 (*read16)(u32 addr) = NULL;
+    u32 (*read32)(u32 addr) = NULL;
+
+    void (*write8 )(u32 addr, u8  data) = NULL;
+    void (*write16)(u32 addr, u16 data) = NULL;
+    void (*write32)(u32 addr, u32 data) = NULL;
+};
+
+constexpr u32 IO_SLOT_COUNT = static_cast<u32>(MemorySize::IO) >> 2;
+
+IORegister ioRegisters[IO_SLOT_COUNT];
+IORegister deviceRegisters[IO_SLOT_COUNT]; // As registered, used by the adapters
+
+u32 getIOSlot(u32 addr) {
+    return ((addr - static_cast<u32>(MemoryBase::IO)) >> 2) & (IO_SLOT_COUNT - 1);
+}
+
+IORegister &getIORegister(u32 addr) {
+    return ioRegisters[getIOSlot(addr)];
+}
+
+u8 unhandledRead8(u32 addr) {
+    std::printf("[Bus       ] Unhandled 8-bit read @ 0x%08X\n", addr);
+
+    exit(0);
+}
+
+u16 unhandledRead16(u32 addr) {
+    std::printf("[Bus       ] Unhandled 16-bit read @ 0x%08X\n", addr);
+
+    exit(0);
+}
+
+u32 unhandledRead32(u32 addr) {
+    std::printf("[Bus       ] Unhandled 32-bit read @ 0x%08X\n", addr);
+
+    exit(0);
+}
+
+void unhandledWrite8(u32 addr, u8 data) {
+    std::printf("[Bus       ] Unhandled 8-bit write @ 0x%08X = 0x%02X\n", addr, data);
+
+    exit(0);
+}
+
+void unhandledWrite16(u32 addr, u16 data) {
+    std::printf("[Bus       ] Unhandled 16-bit write @ 0x%08X = 0x%04X\n", addr, data);
+
+    exit(0);
+}
+
+void unhandledWrite32(u32 addr, u32 data) {
+    std::printf("[Bus       ] Unhandled 32-bit write @ 0x%08X = 0x%08X\n", addr, data);
+
+    exit(0);
+}
+
+/* Narrow accesses to wider registers use the byte lanes of the access */
+u8 read8From16(u32 addr) {
+    return deviceRegisters[getIOSlot(addr)].read16(addr & ~1) >> (8 * (addr & 1));
+}
+
+u8 read8From32(u32 addr) {
+    return deviceRegisters[getIOSlot(addr)].read32(addr & ~3) >> (8 * (addr & 3));
+}
+
+u16 read16From32(u32 addr) {
+    return deviceRegisters[getIOSlot(addr)].read32(addr & ~3) >> (8 * (addr & 2));
+}
+
+void write8To16(u32 addr, u8 data) {
+    deviceRegisters[getIOSlot(addr)].write16(addr & ~1, (u16)data << (8 * (addr & 1)));
+}
+
+/* Narrow writes to 32-bit registers keep the other byte lanes (read-modify-write).
+ * Registers with read side effects must register their own narrow handlers!
+ */
+void write8To32(u32 addr, u8 data) {
+    const auto &dev = deviceRegisters[getIOSlot(addr)];
+
+    const auto shift = 8 * (addr & 3);
+
+    dev.write32(addr & ~3, (dev.read32(addr & ~3) & ~(0xFFu << shift)) | ((u32)data << shift));
+}
+
+void write16To32(u32 addr, u16 data) {
+    const auto &dev = deviceRegisters[getIOSlot(addr)];
+
+    const auto shift = 8 * (addr & 2);
+
+    dev.write32(addr & ~3, (dev.read32(addr & ~3) & ~(0xFFFFu << shift)) | ((u32)data << shift));
+}
+
+/* Wide accesses to narrower registers only reach the addressed register */
+u16 read16From8(u32 addr) {
+    return deviceRegisters[getIOSlot(addr)].read8(addr);
+}
+
+u32 read32From8(u32 addr) {
+    return deviceRegisters[getIOSlot(addr)].read8(addr);
+}
+
+u32 read32From16(u32 addr) {
+    return deviceRegisters[getIOSlot(addr)].read16(addr);
+}
+
+void write16To8(u32 addr, u16 data) {
+    deviceRegisters[getIOSlot(addr)].write8(addr, data);
+}
+
+void write32To8(u32 addr, u32 data) {
+    deviceRegisters[getIOSlot(addr)].write8(addr, data);
+}
+
+void write32To16(u32 addr, u32 data) {
+    deviceRegisters[getIOSlot(addr)].write16(addr, data);
+}
+
+/* 16-bit buses split 32-bit accesses into two halfword accesses */
+u32 read32Split16(u32 addr) {
+    const auto &dev = deviceRegisters[getIOSlot(addr)];
+
+    return dev.read16(addr) | ((u32)dev.read16(addr + 2) << 16);
+}
+
+void write32Split16(u32 addr, u32 data) {
+    const auto &dev = deviceRegisters[getIOSlot(addr)];
+
+    dev.write16(addr, data);
+    dev.write16(addr + 2, data >> 16);
+}
+
+/* Registers device handlers for [base;base+size), NULL: not implemented by the device */
+void mapIO(MemoryBase base, MemorySize size, const IORegister &handlers) {
+    for (u32 addr = static_cast<u32>(base); addr < (static_cast<u32>(base) + static_cast<u32>(size)); addr += 4) {
+        deviceRegisters[getIOSlot(addr)] = handlers;
+    }
+}
+
+/* Fills in missing widths, prefers narrowing a wider handler */
+void adaptIO() {
+    for (u32 i = 0; i < IO_SLOT_COUNT; i++) {
+        const auto &dev = deviceRegisters[i];
+
+        auto &reg = ioRegisters[i];
+
+        reg = dev;
+
+        if (!reg.read8 ) reg.read8  = (dev.read16) ? read8From16 : (dev.read32) ? read8From32 : unhandledRead8;
+        if (!reg.read16) reg.read16 = (dev.read32) ? read16From32 : (dev.read8) ? read16From8 : unhandledRead16;
+        if (!reg.read32) reg.read32 = (dev.read16) ? read32From16 : (dev.read8) ? read32From8 : unhandledRead32;
+
+        if (!reg.write8 ) reg.write8  = (dev.write16) ? write8To16 : (dev.write32) ? write8To32 : unhandledWrite8;
+        if (!reg.write16) reg.write16 = (dev.write32) ? write16To32 : (dev.write8) ? write16To8 : unhandledWrite16;
+        if (!reg.write32) reg.write32 = (dev.write16) ? write32To16 : (dev.write8) ? write32To8 : unhandledWrite32;
+    }
+}
+
+/* --- Memory control (wait states) --- */
+
+enum MemCtrlReg {
+    EXP1_BASE, EXP2_BASE,
+    EXP1_DELAY, EXP3_DELAY, BIOS_DELAY, SPU_DELAY, CDROM_DELAY, EXP2_DELAY, // Delay/size registers
+    COM_DELAY,
+};
+
+/* Values written by the BIOS */
+u32 memCtrl[] = {
+    0x1F000000, 0x1F802000,
+    0x0013243F, 0x00003022, 0x0013243F, 0x200931E1, 0x00020843, 0x00070777,
+    0x00031125,
+};
+
+/* Read wait states (cycles on top of the load instruction) per page and I/O register slot, 0 for RAM, scratchpad and internal registers.
+ * Writes go through the write buffer and don't stall.
+ */
+u8 readCycles8[PAGE_COUNT], readCycles16[PAGE_COUNT], readCycles32[PAGE_COUNT];
+u8 ioReadCycles8[IO_SLOT_COUNT], ioReadCycles16[IO_SLOT_COUNT], ioReadCycles32[IO_SLOT_COUNT];
+
+/* Access time of a region */
+struct AccessCycles {
+    u8 byte, half, word;
+};
+
+/* Calculates the read access time of a delay/size register setting */
+AccessCycles getAccessCycles(u32 delay) {
+    const auto com = memCtrl[COM_DELAY];
+
+    const i32 com0 = com & 0xF;
+    const i32 com2 = (com >> 8) & 0xF;
+    const i32 com3 = (com >> 12) & 0xF;
+
+    const i32 accessTime = (delay >> 4) & 0xF;
+
+    i32 first = 0, seq = 0, min = 0;
+
+    if (delay & (1 << 8)) { first += com0 - 1; seq += com0 - 1; }
+    if (delay & (1 << 10)) { first += com2; seq += com2; }
+    if (delay & (1 << 11)) min = com3;
+
+    if (first < 6) first++;
+
+    first = std::max(first + accessTime + 2, min + 6);
+    seq   = std::max(seq + accessTime + 2, min + 2);
+
+    /* 32-bit accesses are split into 16-bit or 8-bit accesses, the first cycle is part of the load instruction */
+    if (delay & (1 << 12)) return AccessCycles{(u8)(first - 1), (u8)(first - 1), (u8)(first + seq - 1)};
+
+    return AccessCycles{(u8)(first - 1), (u8)(first + seq - 1), (u8)(first + 3 * seq - 1)};
+}
+
+void setPageCycles(u32 base, u32 size, const AccessCycles &access) {
+    for (u32 addr = base; (addr - base) < size; addr += PAGE_SIZE) {
+        const auto page = getPage(addr);
+
+        readCycles8[page]  = access.byte;
+        readCycles16[page] = access.half;
+        readCycles32[page] = access.word;
+    }
+}
+
+void setIOCycles(MemoryBase base, MemorySize size, const AccessCycles &access) {
+    for (u32 addr = static_cast<u32>(base); addr < (static_cast<u32>(base) + static_cast<u32>(size)); addr += 4) {
+        const auto slot = getIOSlot(addr);
+
+        ioReadCycles8[slot]  = access.byte;
+        ioReadCycles16[slot] = access.half;
+        ioReadCycles32[slot] = access.word;
+    }
+}
+
+/* Rebuilds the wait state tables (after MEMCTRL writes) */
+void updateAccessCycles() {
+    std::memset(readCycles8, 0, sizeof(readCycles8));
+    std::memset(readCycles16, 0, sizeof(readCycles16));
+    std::memset(readCycles32, 0, sizeof(readCycles32));
+
+    /* EXP1 can't reach into the scratchpad or the I/O registers */
+    setPageCycles(exp1Base, std::min(exp1Size, static_cast<u32>(MemoryBase::SPRAM) - exp1Base), getAccessCycles(memCtrl[EXP1_DELAY]));
+    setPageCycles(exp3Base, std::min(exp3Size, static_cast<u32>(MemoryBase::BIOS) - exp3Base), getAccessCycles(memCtrl[EXP3_DELAY]));
+    setPageCycles(static_cast<u32>(MemoryBase::BIOS), static_cast<u32>(MemorySize::BIOS), getAccessCycles(memCtrl[BIOS_DELAY]));
+
+    setIOCycles(MemoryBase::SPU, MemorySize::SPU, getAccessCycles(memCtrl[SPU_DELAY]));
+    setIOCycles(MemoryBase::CDROM, MemorySize::CDROM, getAccessCycles(memCtrl[CDROM_DELAY]));
+    setIOCycles(MemoryBase::POST, MemorySize::POST, getAccessCycles(memCtrl[EXP2_DELAY]));
+}
+
+u32 readMemCtrl(u32 addr) {
+    //std::printf("[Bus       ] 32-bit read @ MEMCTRL 0x%08X\n", addr);
+
+    return memCtrl[(addr >> 2) & 0xF];
+}
+
+void writeMemCtrl(u32 addr, u32 data) {
+    const auto idx = (addr >> 2) & 0xF;
+
+    //std::printf("[Bus       ] 32-bit write @ MEMCTRL 0x%08X = 0x%08X\n", addr, data);
+
+    switch (idx) {
+        case EXP1_BASE : exp1Base = (exp1Base & 0xFF000000) | (data & 0xFFFFFF); break;
+        case EXP2_BASE : exp2Base = (exp2Base & 0xFF000000) | (data & 0xFFFFFF); break;
+        case EXP1_DELAY: exp1Size = 1 << ((data >> 16) & 0x1F); break;
+        case EXP3_DELAY: exp3Size = 1 << ((data >> 16) & 0x1F); break;
+        case EXP2_DELAY: exp2Size = 1 << ((data >> 16) & 0x1F); break;
+        default: break;
+    }
+
+    memCtrl[idx] = data;
+
+    updateAccessCycles();
+}
+
+/* Halfword writes only replace their half of the register */
+void writeMemCtrl16(u32 addr, u16 data) {
+    const auto shift = 8 * (addr & 2);
+
+    writeMemCtrl(addr, (memCtrl[(addr >> 2) & 0xF] & ~(0xFFFFu << shift)) | ((u32)data << shift));
+}
+
+u16 readINTC(u32 addr) {
+    switch (addr) {
+        case 0x1F801070: return intc::readStat();
+        case 0x1F801074: return intc::readMask();
+        default        : return unhandledRead16(addr);
+    }
+}
+
+void writeINTC(u32 addr, u16 data) {
+    switch (addr) {
+        case 0x1F801070: return intc::writeStat(data);
+        case 0x1F801074: return intc::writeMask(data);
+        default        : return unhandledWrite16(addr, data);
+    }
+}
+
+u32 readGPU(u32 addr) {
+    return (addr == 0x1F801810) ? gpu::readGPUREAD() : gpu::readStatus();
+}
+
+void writeGPU(u32 addr, u32 data) {
+    if (addr == 0x1F801810) {
+        gpu::writeGP0(data);
+    } else {
+        gpu::writeGP1(data);
+    }
+}
+
+u32 readMDEC(u32 addr) {
+    return (addr == 0x1F801820) ? mdec::readData() : mdec::readStat();
+}
+
+void writeMDEC(u32 addr, u32 data) {
+    if (addr == 0x1F801820) {
+        mdec::writeCmd(data);
+    } else {
+        mdec::writeCtrl(data);
+    }
+}
+
+/* Builds the I/O register table */
+void initIO() {
+    mapIO(MemoryBase::MemCtrl, MemorySize::MemCtrl, {.read32 = readMemCtrl, .write16 = writeMemCtrl16, .write32 = writeMemCtrl});
+    mapIO(MemoryBase::SIO, MemorySize::SIO, {.read8 = sio::read8, .read16 = sio::read16, .write8 = sio::write8, .write16 = sio::write16});
+    mapIO(MemoryBase::RAMSize, MemorySize::RAMSize, {
+        .read32  = [](u32) -> u32 { return 0x00000B88; },
+        .write32 = [](u32, u32) {},
+    });
+    mapIO(MemoryBase::INTC, MemorySize::INTC, {.read16 = readINTC, .write16 = writeINTC});
+    /* DMA, GPU and MDEC reads have side effects or return different registers, no narrow writes */
+    mapIO(MemoryBase::DMA, MemorySize::DMA, {.read32 = dmac::read, .write8 = dmac::write8, .write16 = unhandledWrite16, .write32 = dmac::write32});
+    mapIO(MemoryBase::Timer, MemorySize::Timer, {.read16 = timer::read, .write16 = timer::write});
+    mapIO(MemoryBase::CDROM, MemorySize::CDROM, {.read8 = cdrom::read, .write8 = cdrom::write});
+    mapIO(MemoryBase::GPU, MemorySize::GPU, {.read32 = readGPU, .write8 = unhandledWrite8, .write16 = unhandledWrite16, .write32 = writeGPU});
+    mapIO(MemoryBase::MDEC, MemorySize::MDEC, {.read32 = readMDEC, .write8 = unhandledWrite8, .write16 = unhandledWrite16, .write32 = writeMDEC});
+    mapIO(MemoryBase::SPU, MemorySize::SPU, {.read16 = spu::read, .read32 = read32Split16, .write16 = spu::write, .write32 = write32Split16});
+
+    adaptIO();
+
+    updateAccessCycles();
+}
+
+/* Maps a BIOS image, checks its size and looks it up in the BIOS database */
+void loadBIOS(const char *biosPath) {
+    const auto file = mapFile(biosPath);
+
+    if (!file.data) {
+        std::printf("[Bus       ] Unable to open BIOS \"%s\"\n", biosPath);
+
+        exit(0);
+    }
+
+    if (file.size != static_cast<size_t>(MemorySize::BIOS)) {
+        std::printf("[Bus       ] Invalid BIOS size %zu (expected %zu)\n", file.size, static_cast<size_t>(MemorySize::BIOS));
+
+        exit(0);
+    }
+
+    bios = file.data;
+
+    const auto crc = crc32(bios, file.size);
+
+    for (const auto &info : knownBIOS) {
+        if (info.crc == crc) {
+            std::printf("[Bus       ] BIOS: %s v%s (%s)\n", info.model, info.version, info.region);
+
+            return;
+        }
+    }
+
+    std::printf("[Bus       ] Unknown BIOS (CRC32 = 0x%08X)\n", crc);
+}
+
 void init(const char *biosPath, const char *exePath) {
     ram.resize(static_cast<int>(MemorySize::RAM));
 
     if (exePath) {
-        std::strncpy(path, exePath, 256);
+        std::strncpy(path, exePath, sizeof(path) - 1);
+
+        path[sizeof(path) - 1] = 0;
 
         enableEXE = true;
     }
 
-    bios = loadBinary(biosPath);
+    if (biosPath) {
+        loadBIOS(biosPath);
+    } else {
+        bios = noBIOS;
+    }
 
-    assert(bios.size() == static_cast<u64>(MemorySize::BIOS));
+    mapPages();
+
+    initIO();
 
     //std::printf("[Bus       ] Init OK\n");
 }
 
-/* Reads a byte from the system bus */
-u8 read8(u32 addr) {
-    if (inRange(addr, exp1Base, exp1Size)) {
-        //std::printf("[Bus       ] 8-bit read @ 0x%08X (EXP1)\n", addr);
+/* Reads a byte from the system bus, CPU accesses are charged wait states */
+template<bool isCPUAccess>
+u8 doRead8(u32 addr) {
+    if constexpr (isCPUAccess) cpu::addStall(readCycles8[getPage(addr)]);
 
-        return 0;
-    }
+    if (const auto page = readPages[getPage(addr)]; page) return page[addr & (PAGE_SIZE - 1)];
 
     if (inRange(addr, static_cast<u32>(MemoryBase::RAM), static_cast<u32>(MemorySize::RAM))) {
+        debugger::checkRead(addr, sizeof(u8), ram[addr]);
+
         return ram[addr];
     } else if (inRange(addr, static_cast<u32>(MemoryBase::SPRAM), static_cast<u32>(MemorySize::SPRAM))) {
         return spram[addr & 0x3FF];
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::SIO), static_cast<u32>(MemorySize::SIO))) {
-        return sio::read8(addr);
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::DMA), static_cast<u32>(MemorySize::DMA))) {
-        return dmac::read(addr & ~3) >> (8 * (addr & 3));
     } else if (inRange(addr, static_cast<u32>(MemoryBase::BIOS), static_cast<u32>(MemorySize::BIOS))) {
         return bios[addr - static_cast<u32>(MemoryBase::BIOS)];
-    } else {
-        switch (addr) {
-            case 0x1F801800: case 0x1F801801: case 0x1F801802: case 0x1F801803:
-                return cdrom::read(addr);
-            default:
-                std::printf("[Bus       ] Unhandled 8-bit read @ 0x%08X\n", addr);
+    }
 
-                exit(0);
-        }
+    /* Everything below is I/O */
+    PROFILE_SCOPE(profiler::Zone::BusIO);
+
+    if (inRange(addr, static_cast<u32>(MemoryBase::IO), static_cast<u32>(MemorySize::IO))) {
+        if constexpr (isCPUAccess) cpu::addStall(ioReadCycles8[getIOSlot(addr)]);
+
+        return getIORegister(addr).read8(addr);
+    }
+
+    if (inRange(addr, exp1Base, exp1Size)) {
+        //std::printf("[Bus       ] 8-bit read @ 0x%08X (EXP1)\n", addr);
+
+        return 0;
     }
+
+    return unhandledRead8(addr);
 }
 
-/* Reads a halfword from the system bus */
-u16 read16(u32 addr) {
+/* Reads a halfword from the system bus, CPU accesses are charged wait states */
+template<bool isCPUAccess>
+u16 doRead16(u32 addr) {
     u16 data;
 
+    if constexpr (isCPUAccess) cpu::addStall(readCycles16[getPage(addr)]);
+
+    if (const auto page = readPages[getPage(addr)]; page) {
+        std::memcpy(&data, &page[addr & (PAGE_SIZE - 1)], sizeof(u16));
+
+        return data;
+    }
+
     if (inRange(addr, static_cast<u32>(MemoryBase::RAM), static_cast<u32>(MemorySize::RAM))) {
         std::memcpy(&data, &ram[addr], sizeof(u16));
+
+        debugger::checkRead(addr, sizeof(u16), data);
     } else if (inRange(addr, static_cast<u32>(MemoryBase::SPRAM), static_cast<u32>(MemorySize::SPRAM))) {
         std::memcpy(&data, &spram[addr & 0x3FE], sizeof(u16));
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::SIO), static_cast<u32>(MemorySize::SIO))) {
-        return sio::read16(addr);
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::Timer), static_cast<u32>(MemorySize::Timer))) {
-        return timer::read(addr);
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::SPU), static_cast<u32>(MemorySize::SPU))) {
-        return spu::read(addr);
     } else if (inRange(addr, static_cast<u32>(MemoryBase::BIOS), static_cast<u32>(MemorySize::BIOS))) {
         std::memcpy(&data, &bios[addr - static_cast<u32>(MemoryBase::BIOS)], sizeof(u16));
     } else {
-        switch (addr) {
-            case 0x1F801014:
-                //std::printf("[Bus       ] 16-bit read @ SPU_DELAY\n");
-                return 0x31E1;
-            case 0x1F801016:
-                //std::printf("[Bus       ] 16-bit read @ SPU_DELAY\n");
-                return 0x2009;
-            case 0x1F801070:
-                ////std::printf("[Bus       ] 16-bit read @ I_STAT\n");
-                return intc::readStat();
-            case 0x1F801074:
-                ////std::printf("[Bus       ] 16-bit read @ I_MASK\n");
-                return intc::readMask();
-            default:
-                std::printf("[Bus       ] Unhandled 16-bit read @ 0x%08X\n", addr);
-
-                exit(0);
+        /* Everything below is I/O */
+        PROFILE_SCOPE(profiler::Zone::BusIO);
+
+        if (inRange(addr, static_cast<u32>(MemoryBase::IO), static_cast<u32>(MemorySize::IO))) {
+            if constexpr (isCPUAccess) cpu::addStall(ioReadCycles16[getIOSlot(addr)]);
+
+            return getIORegister(addr).read16(addr);
         }
+
+        return unhandledRead16(addr);
     }
 
     return data;
 }
 
-/* Reads a word from the system bus */
-u32 read32(u32 addr) {
+/* Reads a word from the system bus, CPU accesses are charged wait states */
+template<bool isCPUAccess>
+u32 doRead32(u32 addr) {
     u32 data;
 
+    if constexpr (isCPUAccess) cpu::addStall(readCycles32[getPage(addr)]);
+
+    if (const auto page = readPages[getPage(addr)]; page) {
+        std::memcpy(&data, &page[addr & (PAGE_SIZE - 1)], sizeof(u32));
+
+        return data;
+    }
+
     if (inRange(addr, static_cast<u32>(MemoryBase::RAM), static_cast<u32>(MemorySize::RAM))) {
         std::memcpy(&data, &ram[addr], sizeof(u32));
+
+        debugger::checkRead(addr, sizeof(u32), data);
     } else if (inRange(addr, static_cast<u32>(MemoryBase::SPRAM), static_cast<u32>(MemorySize::SPRAM))) {
         std::memcpy(&data, &spram[addr & 0x3FC], sizeof(u32));
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::DMA), static_cast<u32>(MemorySize::DMA))) {
-        return dmac::read(addr);
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::Timer), static_cast<u32>(MemorySize::Timer))) {
-        return timer::read(addr);
     } else if (inRange(addr, static_cast<u32>(MemoryBase::BIOS), static_cast<u32>(MemorySize::BIOS))) {
         std::memcpy(&data, &bios[addr - static_cast<u32>(MemoryBase::BIOS)], sizeof(u32));
     } else {
-        switch (addr) {
-            case 0x1F801014:
-                //std::printf("[Bus       ] 32-bit read @ SPU_DELAY\n");
-                return 0x200931E1;
-            case 0x1F80101C:
-                //std::printf("[Bus       ] 32-bit read @ EXP2_SIZE\n");
-                return exp2Size;
-            case 0x1F801060:
-                //std::printf("[Bus       ] 32-bit read @ RAM_SIZE\n");
-                return 0x00000B88;
-            case 0x1F801070:
-                ////std::printf("[Bus       ] 32-bit read @ I_STAT\n");
-                return intc::readStat();
-            case 0x1F801074:
-                ////std::printf("[Bus       ] 32-bit read @ I_MASK\n");
-                return intc::readMask();
-            case 0x1F801810:
-                //std::printf("[Bus       ] 32-bit read @ GPUREAD\n");
-                return gpu::readGPUREAD();
-            case 0x1F801814:
-                ////std::printf("[Bus       ] Unhandled 32-bit read @ GP1\n");
-                return gpu::readStatus();
-            case 0x1F801824:
-                return mdec::readStat();
-            default:
-                std::printf("[Bus       ] Unhandled 32-bit read @ 0x%08X\n", addr);
-
-                exit(0);
+        /* Everything below is I/O */
+        PROFILE_SCOPE(profiler::Zone::BusIO);
+
+        if (inRange(addr, static_cast<u32>(MemoryBase::IO), static_cast<u32>(MemorySize::IO))) {
+            if constexpr (isCPUAccess) cpu::addStall(ioReadCycles32[getIOSlot(addr)]);
+
+            return getIORegister(addr).read32(addr);
         }
+
+        return unhandledRead32(addr);
     }
 
     return data;
 }
 
+u8 read8(u32 addr) {
+    return doRead8<false>(addr);
+}
+
+u16 read16(u32 addr) {
+    return doRead16<false>(addr);
+}
+
+u32 read32(u32 addr) {
+    return doRead32<false>(addr);
+}
+
+u8 readCPU8(u32 addr) {
+    return doRead8<true>(addr);
+}
+
+u16 readCPU16(u32 addr) {
+    return doRead16<true>(addr);
+}
+
+u32 readCPU32(u32 addr) {
+    return doRead32<true>(addr);
+}
+
 /* Writes a byte to the system bus */
 void write8(u32 addr, u8 data) {
+    if (const auto page = writePages[getPage(addr)]; page) {
+        page[addr & (PAGE_SIZE - 1)] = data;
+
+        return attr::checkWrite(attr::Region::RAM, addr, sizeof(u8));
+    }
+
+    if (inRange(addr, static_cast<u32>(MemoryBase::SPRAM), static_cast<u32>(MemorySize::SPRAM))) {
+        spram[addr & 0x3FF] = data;
+
+        return attr::checkWrite(attr::Region::SPRAM, addr, sizeof(u8));
+    }
+
+    /* Everything below is I/O */
+    PROFILE_SCOPE(profiler::Zone::BusIO);
+
+    /* EXP2 can be moved by MEMCTRL, only 8-bit writes (boot status display) are handled */
     if (inRange(addr, exp2Base, exp2Size)) {
         if (addr == (exp2Base + 0x41)) {
             //std::printf("[PS        ] POST = 0x%02X\n", data);
@@ -211,150 +702,96 @@ void write8(u32 addr, u8 data) {
         return;
     }
 
-    if (inRange(addr, static_cast<u32>(MemoryBase::RAM), static_cast<u32>(MemorySize::RAM))) {
-        ram[addr] = data;
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::SPRAM), static_cast<u32>(MemorySize::SPRAM))) {
-        spram[addr & 0x3FF] = data;
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::SIO), static_cast<u32>(MemorySize::SIO))) {
-        return sio::write8(addr, data);
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::DMA), static_cast<u32>(MemorySize::DMA))) {
-        return dmac::write8(addr, data);
-    } else {
-        switch (addr) {
-            case 0x1F801800: case 0x1F801801: case 0x1F801802: case 0x1F801803:
-                return cdrom::write(addr, data);
-            default:
-                std::printf("[Bus       ] Unhandled 8-bit write @ 0x%08X = 0x%02X\n", addr, data);
+    if (inRange(addr, static_cast<u32>(MemoryBase::IO), static_cast<u32>(MemorySize::IO))) return getIORegister(addr).write8(addr, data);
 
-                exit(0);
-        }
-    }
+    return unhandledWrite8(addr, data);
 }
 
 /* Writes a halfword to the system bus */
 void write16(u32 addr, u16 data) {
-    if (inRange(addr, static_cast<u32>(MemoryBase::RAM), static_cast<u32>(MemorySize::RAM))) {
-        std::memcpy(&ram[addr], &data, sizeof(u16));
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::SPRAM), static_cast<u32>(MemorySize::SPRAM))) {
+    if (const auto page = writePages[getPage(addr)]; page) {
+        std::memcpy(&page[addr & (PAGE_SIZE - 1)], &data, sizeof(u16));
+
+        return attr::checkWrite(attr::Region::RAM, addr, sizeof(u16));
+    }
+
+    if (inRange(addr, static_cast<u32>(MemoryBase::SPRAM), static_cast<u32>(MemorySize::SPRAM))) {
         std::memcpy(&spram[addr & 0x3FE], &data, sizeof(u16));
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::SIO), static_cast<u32>(MemorySize::SIO))) {
-        return sio::write16(addr, data);
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::Timer), static_cast<u32>(MemorySize::Timer))) {
-        return timer::write(addr, data);
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::SPU), static_cast<u32>(MemorySize::SPU))) {
-        return spu::write(addr, data);
+
+        attr::checkWrite(attr::Region::SPRAM, addr, sizeof(u16));
     } else {
-        switch (addr) {
-            case 0x1F801014:
-                //std::printf("[Bus       ] 16-bit write @ SPU_DELAY = 0x%04X\n", data);
-                break;
-            case 0x1F801016:
-                //std::printf("[Bus       ] 16-bit write @ SPU_DELAY = 0x%04X\n", data);
-                break;
-            case 0x1F801070:
-                ////std::printf("[Bus       ] 16-bit write @ I_STAT = 0x%04X\n", data);
-                return intc::writeStat(data);
-            case 0x1F801074:
-                //std::printf("[Bus       ] 16-bit write @ I_MASK = 0x%04X\n", data);
-                return intc::writeMask(data);
-            default:
-                std::printf("[Bus       ] Unhandled 16-bit write @ 0x%08X = 0x%04X\n", addr, data);
-
-                exit(0);
-        }
+        /* Everything below is I/O */
+        PROFILE_SCOPE(profiler::Zone::BusIO);
+
+        if (inRange(addr, static_cast<u32>(MemoryBase::IO), static_cast<u32>(MemorySize::IO))) return getIORegister(addr).write16(addr, data);
+
+        return unhandledWrite16(addr, data);
     }
 }
 
 /* Writes a word to the system bus */
 void write32(u32 addr, u32 data) {
-    if (inRange(addr, static_cast<u32>(MemoryBase::RAM), static_cast<u32>(MemorySize::RAM))) {
-        std::memcpy(&ram[addr], &data, sizeof(u32));
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::SPRAM), static_cast<u32>(MemorySize::SPRAM))) {
+    if (const auto page = writePages[getPage(addr)]; page) {
+        std::memcpy(&page[addr & (PAGE_SIZE - 1)], &data, sizeof(u32));
+
+        return attr::checkWrite(attr::Region::RAM, addr, sizeof(u32));
+    }
+
+    if (inRange(addr, static_cast<u32>(MemoryBase::SPRAM), static_cast<u32>(MemorySize::SPRAM))) {
         std::memcpy(&spram[addr & 0x3FC], &data, sizeof(u32));
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::DMA), static_cast<u32>(MemorySize::DMA))) {
-        return dmac::write32(addr, data);
-    } else if (inRange(addr, static_cast<u32>(MemoryBase::Timer), static_cast<u32>(MemorySize::Timer))) {
-        return timer::write(addr, data);
+
+        attr::checkWrite(attr::Region::SPRAM, addr, sizeof(u32));
     } else {
-        switch (addr) {
-            case 0x1F801000:
-                //std::printf("[Bus       ] 32-bit write @ EXP1_BASE = 0x%08X\n", data);
-
-                exp1Base = (exp1Base & 0xFF000000) | (data & 0xFFFFFF);
-                break;
-            case 0x1F801004:
-                //std::printf("[Bus       ] 32-bit write @ EXP2_BASE = 0x%08X\n", data);
-
-                exp2Base = (exp2Base & 0xFF000000) | (data & 0xFFFFFF);
-                break;
-            case 0x1F801008:
-                //std::printf("[Bus       ] 32-bit write @ EXP1_SIZE = 0x%08X\n", data);
-
-                exp1Size = 1 << ((data >> 16) & 0x1F);
-                break;
-            case 0x1F80100C:
-                //std::printf("[Bus       ] 32-bit write @ EXP3_SIZE = 0x%08X\n", data);
-
-                exp3Size = 1 << ((data >> 16) & 0x1F);
-                break;
-            case 0x1F801010:
-                //std::printf("[Bus       ] 32-bit write @ BIOS_DELAY = 0x%08X\n", data);
-                break;
-            case 0x1F801014:
-                //std::printf("[Bus       ] 32-bit write @ SPU_DELAY = 0x%08X\n", data);
-                break;
-            case 0x1F801018:
-                //std::printf("[Bus       ] 32-bit write @ CDROM_DELAY = 0x%08X\n", data);
-                break;
-            case 0x1F80101C:
-                //std::printf("[Bus       ] 32-bit write @ EXP2_SIZE = 0x%08X\n", data);
-
-                exp2Size = 1 << ((data >> 16) & 0x1F);
-                break;
-            case 0x1F801020:
-                //std::printf("[Bus       ] 32-bit write @ COM_DELAY = 0x%08X\n", data);
-                break;
-            case 0x1F801060:
-                //std::printf("[Bus       ] 32-bit write @ RAM_SIZE = 0x%08X\n", data);
-                break;
-            case 0x1F801070:
-                ////std::printf("[Bus       ] 32-bit write @ I_STAT = 0x%08X\n", data);
-                return intc::writeStat(data);
-            case 0x1F801074:
-                //std::printf("[Bus       ] 32-bit write @ I_MASK = 0x%08X\n", data);
-                return intc::writeMask(data);
-            case 0x1F801810:
-                //std::printf("[Bus       ] 32-bit write @ GP0 = 0x%08X\n", data);
-
-                gpu::writeGP0(data);
-                break;
-            case 0x1F801814:
-                //std::printf("[Bus       ] 32-bit write @ GP1 = 0x%08X\n", data);
-
-                gpu::writeGP1(data);
-                break;
-            case 0x1F801820:
-                return mdec::writeCmd(data);
-            case 0x1F801824:
-                return mdec::writeCtrl(data);
-            case 0x1FFE0130:
-                //std::printf("[Bus       ] 32-bit write @ CACHE_CONTROL = 0x%08X\n", data);
-                break;
-            default:
-                std::printf("[Bus       ] Unhandled 32-bit write @ 0x%08X = 0x%08X\n", addr, data);
-
-                exit(0);
+        /* Everything below is I/O */
+        PROFILE_SCOPE(profiler::Zone::BusIO);
+
+        if (inRange(addr, static_cast<u32>(MemoryBase::IO), static_cast<u32>(MemorySize::IO))) return getIORegister(addr).write32(addr, data);
+
+        if (addr == 0x1FFE0130) {
+            //std::printf("[Bus       ] 32-bit write @ CACHE_CONTROL = 0x%08X\n", data);
+
+            return cpu::icache::writeControl(data);
         }
+
+        return unhandledWrite32(addr, data);
     }
 }
 
+/* Reads an instruction word without wait states (charged by the instruction cache), doesn't trigger read watchpoints */
+u32 readCode32(u32 addr) {
+    u32 data;
+
+    if (const auto page = readPages[getPage(addr)]; page) {
+        std::memcpy(&data, &page[addr & (PAGE_SIZE - 1)], sizeof(u32));
+    } else if (inRange(addr, static_cast<u32>(MemoryBase::RAM), static_cast<u32>(MemorySize::RAM))) {
+        std::memcpy(&data, &ram[addr], sizeof(u32));
+    } else {
+        data = read32(addr);
+    }
+
+    return data;
+}
+
+/* Returns the wait states of a 32-bit read */
+u32 getReadCycles32(u32 addr) {
+    return readCycles32[getPage(addr)];
+}
+
 /* Loads a PS-EXE, returns entry point */
 u32 loadEXE() {
     std::printf("Loading PS-EXE...\n");
 
-    const auto exe = loadBinary(path);
+    auto file = mapFile(path);
+
+    if (!file.data) {
+        std::printf("Unable to open PS-EXE \"%s\"\n", path);
 
-    if (std::strncmp((char *)exe.data(), "PS-X EXE", 8) != 0) {
+        exit(0);
+    }
+
+    const auto exe = file.data;
+
+    if ((file.size < 0x800) || (std::strncmp((const char *)exe, "PS-X EXE", 8) != 0)) {
         std::printf("Invalid PS-EXE\n");
 
         exit(0);
@@ -384,8 +821,18 @@ u32 loadEXE() {
 
     addr &= 0x1FFFFC;
 
+    if (((0x800 + (u64)size) > file.size) || ((addr + (u64)size) > static_cast<u64>(MemorySize::RAM))) {
+        std::printf("Invalid PS-EXE size 0x%X\n", size);
+
+        exit(0);
+    }
+
     std::memcpy(&ram[addr], &exe[0x800], size);
 
+    attr::checkWriteRange(attr::Region::RAM, addr, size);
+
+    unmapFile(file);
+
     enableEXE = false;
 
     return entry;
@@ -395,4 +842,12 @@ bool isEXEEnabled() {
     return enableEXE;
 }
 
+u8 *getRAM() {
+    return ram.data();
+}
+
+u8 *getSPRAM() {
+    return spram;
+}
+
 }
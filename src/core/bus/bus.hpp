@@ -15,12 +15,25 @@ u8  read8(u32 addr);
 u16 read16(u32 addr);
 u32 read32(u32 addr);
 
+/* CPU loads, charge wait states */
+u8  readCPU8(u32 addr);
+u16 readCPU16(u32 addr);
+u32 readCPU32(u32 addr);
+
+u32 readCode32(u32 addr);
+
+u32 getReadCycles32(u32 addr);
+
 void write8(u32 addr, u8 data);
 void write16(u32 addr, u16 data);
 void write32(u32 addr, u32 data);
 
 u32 loadEXE();
 
+/* Direct memory access for the recompiler */
+u8 *getRAM();
+u8 *getSPRAM();
+
 bool isEXEEnabled();
 
 }
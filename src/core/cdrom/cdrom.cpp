@@ -7,11 +7,14 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <queue>
 
 #include "../intc.hpp"
+#include "../profiler.hpp"
 #include "../scheduler.hpp"
+#include "../tracer.hpp"
 
 namespace ps::cdrom {
 
@@ -102,6 +105,8 @@ std::queue<u8> queuedResp, lateResp;
 int queuedIRQ = 0;
 bool oldCmdWasSeekL = true;
 
+bool isCmdTraced = false; // Command span is open until the first response
+
 SeekParam seekParam;
 
 u8 readBuf[SECTOR_SIZE];
@@ -137,6 +142,14 @@ void sendIRQEvent(int irq) {
 
     //std::printf("[CDROM     ] INT%d\n", irq);
 
+    tracer::instant("cdrom", "irq", "int", irq);
+
+    if (isCmdTraced && ((irq == 3) || (irq == 5))) {
+        tracer::asyncEnd("cdrom", "command", 0);
+
+        isCmdTraced = false;
+    }
+
     iFlags = (u8)irq;
 
     if (iEnable & iFlags) intc::sendInterrupt(Interrupt::CDROM);
@@ -159,6 +172,9 @@ void sendIRQEvent(int irq) {
 }
 
 void readSector() {
+    PROFILE_SCOPE(profiler::Zone::CDROMRead);
+    PROFILE_CYCLES(profiler::Zone::CDROMRead, (mode & static_cast<u8>(Mode::Speed)) ? READ_TIME_DOUBLE : READ_TIME_SINGLE);
+
     auto &s = seekParam;
 
     /* Calculate seek target (in sectors) */
@@ -613,6 +629,14 @@ void doSubCmd() {
 void doCmd(u8 data) {
     cmd = data;
 
+    if (tracer::enabled) {
+        if (isCmdTraced) tracer::asyncEnd("cdrom", "command", 0);
+
+        tracer::asyncBegin("cdrom", "command", 0, "cmd", cmd);
+
+        isCmdTraced = true;
+    }
+
     switch (cmd) {
         case Command::GetStat  : cmdGetStat(); break;
         case Command::SetLoc   : cmdSetLoc(); break;
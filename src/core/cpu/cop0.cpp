@@ -7,6 +7,7 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
 
 #include "cpu.hpp"
 
@@ -62,8 +63,14 @@ Status status;
 u32 badvaddr;
 u32 epc; // Exception program counter
 
+/* Returns true if an interrupt is pending and enabled */
+bool isInterruptPending() {
+    return status.cie && (status.im & cause.ip);
+}
+
+/* Lets the CPU take a pending interrupt at the next instruction boundary */
 void checkInterrupt() {
-    if (status.cie && (status.im & cause.ip)) cpu::doInterrupt();
+    if (isInterruptPending()) cpu::requestInterrupt();
 }
 
 void init() {
@@ -36,6 +36,8 @@ void leaveException();
 
 void setInterruptPending(bool irq);
 
+bool isInterruptPending();
+
 bool isBEV();
 bool isCacheIsolated();
 
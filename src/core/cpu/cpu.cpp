@@ -7,10 +7,15 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 #include "cop0.hpp"
 #include "gte.hpp"
+#include "hotspot.hpp"
+#include "icache.hpp"
+#include "ir.hpp"
+#include "smc.hpp"
 #include "../bus/bus.hpp"
 
 namespace ps::cpu {
@@ -25,6 +30,13 @@ constexpr u32 SHELL_ENTRY = 0x80030000;
 
 constexpr auto doDisasm = false;
 
+/* Instruction handlers are inlined into both interpreter loops */
+#ifdef __GNUC__
+#define HANDLER inline __attribute__((always_inline))
+#else
+#define HANDLER inline
+#endif
+
 /* --- CPU register definitions --- */
 
 enum CPUReg {
@@ -134,27 +146,96 @@ enum COP0Opcode {
     RFE = 0x10,
 };
 
+/* Fused instruction pairs (superinstructions) */
+enum Fusion : u8 {
+    Unknown,   // Not pre-decoded yet
+    None,
+    LUIORI,    // LUI rt, hi; ORI rt2, rt, lo (32-bit constant)
+    LUIADDIU,  // LUI rt, hi; ADDIU rt2, rt, lo (32-bit constant)
+    LUILW,     // LUI rt, hi; LW rt2, lo(rt) (absolute load)
+    LUISW,     // LUI rt, hi; SW rt2, lo(rt) (absolute store)
+    ADDIUBR,   // ADDIU; BEQ/BNE (loop tail)
+};
+
 /* --- CPU registers --- */
 
-u32 regs[34]; // 32 GPRs, LO, HI
+u32 regs[35]; // 32 GPRs, LO, HI, load delay dummy
 
 u32 pc, cpc, npc; // Program counters
 
 bool inDelaySlot[2]; // Branch delay helper
 
+LoadDelay loadDelay[2] = {{LOAD_DUMMY, 0}, {LOAD_DUMMY, 0}}; // Load delay helper
+
+i64 cycles = 0, stallCycles = 0;
+
+i64 timeBase = 0; // CPU time is timeBase - cycles
+
+/* Interrupts are only taken between time slices, a request ends the current slice early */
+bool isInterruptRequested = false;
+
+i64 deferredCycles = 0; // Rest of the interrupted time slice
+
+/* Multiply/divide unit */
+constexpr i64 DIV_CYCLES = 36;
+
+i64 mulDivReady = 0; // CPU time at which HI/LO are valid
+
+bool useThreaded = false; // Use the computed goto interpreter
+bool useIR       = false; // Use the block recompiler
+
+/* Pre-decoded instruction pairs */
+u8 ramFusion[RAM_SIZE >> 2];
+u8 biosFusion[0x80000 >> 2];
+
 void raiseException(Exception);
 
 /* --- Register accessors --- */
 
+/* Returns the current CPU time in cycles */
+i64 getTime() {
+    return timeBase - cycles;
+}
+
+/* Starts a multiplication or division, HI/LO are written right away but can only be read after the latency */
+void startMulDiv(i64 latency) {
+    mulDivReady = getTime() + latency;
+}
+
+/* Stalls until the multiply/divide unit is done (MFHI/MFLO) */
+void waitMulDiv() {
+    const auto delta = mulDivReady - getTime();
+
+    if (delta > 0) addStall(delta);
+}
+
+/* Returns multiplication latency, depends on the magnitude of rs */
+i64 getMulCycles(u32 rs, bool isSigned) {
+    if (isSigned && ((i32)rs < 0)) rs = ~rs;
+
+    if (rs < 0x800) return 6;
+    if (rs < 0x100000) return 9;
+
+    return 13;
+}
+
 /* Sets a CPU register */
 void set(u32 idx, u32 data) {
     assert(idx < 34);
 
     regs[idx] = data;
 
+    /* Writes cancel a pending load to the same register */
+    loadDelay[0].idx = (loadDelay[0].idx == idx) ? LOAD_DUMMY : loadDelay[0].idx;
+
     regs[0] = 0; // Register 0 is hardwired to 0
 }
 
+/* Returns a register including a pending load from the previous instruction (LWL/LWR merge with it) */
+u32 getPending(u32 idx) {
+    return (loadDelay[0].idx == idx) ? loadDelay[0].data : regs[idx];
+}
+
 /* Sets PC and NPC (exceptions etc...) */
 void setPC(u32 addr) {
     if (addr == 0) {
@@ -207,21 +288,21 @@ void stepPC() {
 
 /* Reads a byte from memory */
 u8 read8(u32 addr) {
-    return bus::read8(addr & 0x1FFFFFFF); // Masking the address like this should be fine
+    return bus::readCPU8(addr & 0x1FFFFFFF); // Masking the address like this should be fine
 }
 
 /* Reads a halfword from memory */
 u16 read16(u32 addr) {
     assert(!(addr & 1));
 
-    return bus::read16(addr & 0x1FFFFFFE); // Masking the address like this should be fine
+    return bus::readCPU16(addr & 0x1FFFFFFE); // Masking the address like this should be fine
 }
 
 /* Reads a word from memory */
 u32 read32(u32 addr) {
     assert(!(addr & 3));
 
-    return bus::read32(addr & 0x1FFFFFFC); // Masking the address like this should be fine
+    return bus::readCPU32(addr & 0x1FFFFFFC); // Masking the address like this should be fine
 }
 
 /* Writes a byte to memory */
@@ -245,7 +326,7 @@ void write32(u32 addr, u32 data) {
 
 /* Fetches an instruction word, advances PC */
 u32 fetchInstr() {
-    const auto instr = read32(cpc);
+    const auto instr = icache::fetch(cpc);
 
     stepPC();
 
@@ -337,7 +418,7 @@ void raiseException(Exception e) {
 /* --- Instruction handlers --- */
 
 /* ADD */
-void iADD(u32 instr) {
+HANDLER void iADD(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -362,7 +443,7 @@ void iADD(u32 instr) {
 }
 
 /* ADD Immediate */
-void iADDI(u32 instr) {
+HANDLER void iADDI(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -388,7 +469,7 @@ void iADDI(u32 instr) {
 }
 
 /* ADD Immediate Unsigned */
-void iADDIU(u32 instr) {
+HANDLER void iADDIU(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -402,7 +483,7 @@ void iADDIU(u32 instr) {
 }
 
 /* ADD Unsigned */
-void iADDU(u32 instr) {
+HANDLER void iADDU(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -415,7 +496,7 @@ void iADDU(u32 instr) {
 }
 
 /* AND */
-void iAND(u32 instr) {
+HANDLER void iAND(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -428,7 +509,7 @@ void iAND(u32 instr) {
 }
 
 /* AND Immediate */
-void iANDI(u32 instr) {
+HANDLER void iANDI(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -442,7 +523,7 @@ void iANDI(u32 instr) {
 }
 
 /* Branch if EQual */
-void iBEQ(u32 instr) {
+HANDLER void iBEQ(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -457,7 +538,7 @@ void iBEQ(u32 instr) {
 }
 
 /* Branch if Greater than or Equal Zero */
-void iBGEZ(u32 instr) {
+HANDLER void iBGEZ(u32 instr) {
     const auto rs = getRs(instr);
 
     const auto offset = (i32)(i16)getImm(instr) << 2;
@@ -471,7 +552,7 @@ void iBGEZ(u32 instr) {
 }
 
 /* Branch if Greater than or Equal Zero And Link */
-void iBGEZAL(u32 instr) {
+HANDLER void iBGEZAL(u32 instr) {
     const auto rs = getRs(instr);
 
     const auto offset = (i32)(i16)getImm(instr) << 2;
@@ -485,7 +566,7 @@ void iBGEZAL(u32 instr) {
 }
 
 /* Branch if Greater Than Zero */
-void iBGTZ(u32 instr) {
+HANDLER void iBGTZ(u32 instr) {
     const auto rs = getRs(instr);
 
     const auto offset = (i32)(i16)getImm(instr) << 2;
@@ -499,7 +580,7 @@ void iBGTZ(u32 instr) {
 }
 
 /* Branch if Less than or Equal Zero */
-void iBLEZ(u32 instr) {
+HANDLER void iBLEZ(u32 instr) {
     const auto rs = getRs(instr);
 
     const auto offset = (i32)(i16)getImm(instr) << 2;
@@ -513,7 +594,7 @@ void iBLEZ(u32 instr) {
 }
 
 /* Branch if Less Than Zero */
-void iBLTZ(u32 instr) {
+HANDLER void iBLTZ(u32 instr) {
     const auto rs = getRs(instr);
 
     const auto offset = (i32)(i16)getImm(instr) << 2;
@@ -527,7 +608,7 @@ void iBLTZ(u32 instr) {
 }
 
 /* Branch if Less Than Zero And Link */
-void iBLTZAL(u32 instr) {
+HANDLER void iBLTZAL(u32 instr) {
     const auto rs = getRs(instr);
 
     const auto offset = (i32)(i16)getImm(instr) << 2;
@@ -541,7 +622,7 @@ void iBLTZAL(u32 instr) {
 }
 
 /* Branch if Not Equal */
-void iBNE(u32 instr) {
+HANDLER void iBNE(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -556,7 +637,7 @@ void iBNE(u32 instr) {
 }
 
 /* BREAKpoint */
-void iBREAK() {
+HANDLER void iBREAK() {
     if (doDisasm) {
         std::printf("[CPU       ] BREAK\n");
     }
@@ -565,7 +646,7 @@ void iBREAK() {
 }
 
 /* Coprocessor move From Control */
-void iCFC(int copN, u32 instr) {
+HANDLER void iCFC(int copN, u32 instr) {
     assert((copN >= 0) && (copN < 4));
 
     const auto rd = getRd(instr);
@@ -583,15 +664,15 @@ void iCFC(int copN, u32 instr) {
             exit(0);
     }
 
-    set(rt, data);
+    setLoad(rt, data);
 
     if (doDisasm) {
-        std::printf("[CPU       ] CFC%d %s, %d; %s = 0x%08X\n", copN, regNames[rt], rd, regNames[rt], regs[rt]);
+        std::printf("[CPU       ] CFC%d %s, %d; %s = 0x%08X\n", copN, regNames[rt], rd, regNames[rt], data);
     }
 }
 
 /* Coprocessor move To Control */
-void iCTC(int copN, u32 instr) {
+HANDLER void iCTC(int copN, u32 instr) {
     assert((copN >= 0) && (copN < 4));
 
     const auto rd = getRd(instr);
@@ -615,10 +696,12 @@ void iCTC(int copN, u32 instr) {
 }
 
 /* DIVide */
-void iDIV(u32 instr) {
+HANDLER void iDIV(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
+    startMulDiv(DIV_CYCLES);
+
     const auto n = (i32)regs[rs];
     const auto d = (i32)regs[rt];
 
@@ -639,10 +722,12 @@ void iDIV(u32 instr) {
 }
 
 /* DIVide Unsigned */
-void iDIVU(u32 instr) {
+HANDLER void iDIVU(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
+    startMulDiv(DIV_CYCLES);
+
     const auto n = regs[rs];
     const auto d = regs[rt];
 
@@ -660,7 +745,7 @@ void iDIVU(u32 instr) {
 }
 
 /* Jump */
-void iJ(u32 instr) {
+HANDLER void iJ(u32 instr) {
     const auto target = (pc & 0xF0000000) | (getOffset(instr) << 2);
 
     doBranch(target, true, CPUReg::R0);
@@ -671,9 +756,11 @@ void iJ(u32 instr) {
 }
 
 /* Jump And Link */
-void iJAL(u32 instr) {
+HANDLER void iJAL(u32 instr) {
     const auto target = (pc & 0xF0000000) | (getOffset(instr) << 2);
 
+    if (hotspot::enabled) hotspot::addCall(target);
+
     doBranch(target, true, CPUReg::RA);
 
     if (doDisasm) {
@@ -682,7 +769,7 @@ void iJAL(u32 instr) {
 }
 
 /* Jump And Link Register */
-void iJALR(u32 instr) {
+HANDLER void iJALR(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
 
@@ -696,6 +783,8 @@ void iJALR(u32 instr) {
         set(CPUReg::S8, 0x801FFF00);
     }
 
+    if (hotspot::enabled) hotspot::addCall(target);
+
     doBranch(target, true, rd);
 
     if (doDisasm) {
@@ -704,7 +793,7 @@ void iJALR(u32 instr) {
 }
 
 /* Jump Register */
-void iJR(u32 instr) {
+HANDLER void iJR(u32 instr) {
     const auto rs = getRs(instr);
 
     const auto target = regs[rs];
@@ -717,7 +806,7 @@ void iJR(u32 instr) {
 }
 
 /* Load Byte */
-void iLB(u32 instr) {
+HANDLER void iLB(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -731,11 +820,11 @@ void iLB(u32 instr) {
 
     assert(!cop0::isCacheIsolated());
 
-    set(rt, (i8)read8(addr));
+    setLoad(rt, (i8)read8(addr));
 }
 
 /* Load Byte Unsigned */
-void iLBU(u32 instr) {
+HANDLER void iLBU(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -749,11 +838,11 @@ void iLBU(u32 instr) {
 
     assert(!cop0::isCacheIsolated());
 
-    set(rt, read8(addr));
+    setLoad(rt, read8(addr));
 }
 
 /* Load Halfword */
-void iLH(u32 instr) {
+HANDLER void iLH(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -776,11 +865,11 @@ void iLH(u32 instr) {
 
     assert(!cop0::isCacheIsolated());
 
-    set(rt, (i16)read16(addr));
+    setLoad(rt, (i16)read16(addr));
 }
 
 /* Load Halfword Unsigned */
-void iLHU(u32 instr) {
+HANDLER void iLHU(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -803,11 +892,11 @@ void iLHU(u32 instr) {
 
     assert(!cop0::isCacheIsolated());
 
-    set(rt, read16(addr));
+    setLoad(rt, read16(addr));
 }
 
 /* Load Upper Immediate */
-void iLUI(u32 instr) {
+HANDLER void iLUI(u32 instr) {
     const auto rt = getRt(instr);
 
     const auto imm = (i32)(i16)getImm(instr) << 16;
@@ -820,7 +909,7 @@ void iLUI(u32 instr) {
 }
 
 /* Load Word */
-void iLW(u32 instr) {
+HANDLER void iLW(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -843,11 +932,11 @@ void iLW(u32 instr) {
 
     assert(!cop0::isCacheIsolated());
 
-    set(rt, read32(addr));
+    setLoad(rt, read32(addr));
 }
 
 /* Load Word Coprocessor */
-void iLWC(int copN, u32 instr) {
+HANDLER void iLWC(int copN, u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -882,7 +971,7 @@ void iLWC(int copN, u32 instr) {
 }
 
 /* Load Word Left */
-void iLWL(u32 instr) {
+HANDLER void iLWL(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -897,11 +986,11 @@ void iLWL(u32 instr) {
     const auto shift = 24 - 8 * (addr & 3);
     const auto mask = ~(~0 << shift);
 
-    set(rt, (regs[rt] & mask) | (read32(addr & ~3) << shift));
+    setLoad(rt, (getPending(rt) & mask) | (read32(addr & ~3) << shift));
 }
 
 /* Load Word Right */
-void iLWR(u32 instr) {
+HANDLER void iLWR(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -916,11 +1005,11 @@ void iLWR(u32 instr) {
     const auto shift = 8 * (addr & 3);
     const auto mask = 0xFFFFFF00 << (24 - shift);
 
-    set(rt, (regs[rt] & mask) | (read32(addr & ~3) >> shift));
+    setLoad(rt, (getPending(rt) & mask) | (read32(addr & ~3) >> shift));
 }
 
 /* Move From Coprocessor */
-void iMFC(int copN, u32 instr) {
+HANDLER void iMFC(int copN, u32 instr) {
     assert((copN >= 0) && (copN < 4));
 
     const auto rd = getRd(instr);
@@ -939,17 +1028,19 @@ void iMFC(int copN, u32 instr) {
             exit(0);
     }
 
-    set(rt, data);
+    setLoad(rt, data);
 
     if (doDisasm) {
-        std::printf("[CPU       ] MFC%d %s, %d; %s = 0x%08X\n", copN, regNames[rt], rd, regNames[rt], regs[rt]);
+        std::printf("[CPU       ] MFC%d %s, %d; %s = 0x%08X\n", copN, regNames[rt], rd, regNames[rt], data);
     }
 }
 
 /* Move From HI */
-void iMFHI(u32 instr) {
+HANDLER void iMFHI(u32 instr) {
     const auto rd = getRd(instr);
 
+    waitMulDiv();
+
     set(rd, regs[CPUReg::HI]);
 
     if (doDisasm) {
@@ -958,9 +1049,11 @@ void iMFHI(u32 instr) {
 }
 
 /* Move From LO */
-void iMFLO(u32 instr) {
+HANDLER void iMFLO(u32 instr) {
     const auto rd = getRd(instr);
 
+    waitMulDiv();
+
     set(rd, regs[CPUReg::LO]);
 
     if (doDisasm) {
@@ -969,7 +1062,7 @@ void iMFLO(u32 instr) {
 }
 
 /* Move To Coprocessor */
-void iMTC(int copN, u32 instr) {
+HANDLER void iMTC(int copN, u32 instr) {
     assert((copN >= 0) && (copN < 4));
 
     const auto rd = getRd(instr);
@@ -994,7 +1087,7 @@ void iMTC(int copN, u32 instr) {
 }
 
 /* Move To HI */
-void iMTHI(u32 instr) {
+HANDLER void iMTHI(u32 instr) {
     const auto rs = getRs(instr);
 
     regs[CPUReg::HI] = regs[rs];
@@ -1005,7 +1098,7 @@ void iMTHI(u32 instr) {
 }
 
 /* Move To LO */
-void iMTLO(u32 instr) {
+HANDLER void iMTLO(u32 instr) {
     const auto rs = getRs(instr);
 
     regs[CPUReg::LO] = regs[rs];
@@ -1016,10 +1109,12 @@ void iMTLO(u32 instr) {
 }
 
 /* MULTiply */
-void iMULT(u32 instr) {
+HANDLER void iMULT(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
+    startMulDiv(getMulCycles(regs[rs], true));
+
     const auto res = (i64)(i32)regs[rs] * (i64)(i32)regs[rt];
 
     regs[CPUReg::LO] = res;
@@ -1031,10 +1126,12 @@ void iMULT(u32 instr) {
 }
 
 /* MULTiply Unsigned */
-void iMULTU(u32 instr) {
+HANDLER void iMULTU(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
+    startMulDiv(getMulCycles(regs[rs], false));
+
     const auto res = (u64)regs[rs] * (u64)regs[rt];
 
     regs[CPUReg::LO] = res;
@@ -1046,7 +1143,7 @@ void iMULTU(u32 instr) {
 }
 
 /* NOR */
-void iNOR(u32 instr) {
+HANDLER void iNOR(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -1059,7 +1156,7 @@ void iNOR(u32 instr) {
 }
 
 /* OR */
-void iOR(u32 instr) {
+HANDLER void iOR(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -1072,7 +1169,7 @@ void iOR(u32 instr) {
 }
 
 /* OR Immediate */
-void iORI(u32 instr) {
+HANDLER void iORI(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -1086,7 +1183,7 @@ void iORI(u32 instr) {
 }
 
 /* Return From Exception */
-void iRFE() {
+HANDLER void iRFE() {
     if (doDisasm) {
         std::printf("[CPU       ] RFE\n");
     }
@@ -1095,7 +1192,7 @@ void iRFE() {
 }
 
 /* Store Byte */
-void iSB(u32 instr) {
+HANDLER void iSB(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -1108,13 +1205,13 @@ void iSB(u32 instr) {
         std::printf("[CPU       ] SB %s, 0x%X(%s); [0x%08X] = 0x%02X\n", regNames[rt], imm, regNames[rs], addr, data);
     }
 
-    if (cop0::isCacheIsolated()) return;
+    if (cop0::isCacheIsolated()) return icache::store(addr);
 
     write8(addr, data);
 }
 
 /* Store Halfword */
-void iSH(u32 instr) {
+HANDLER void iSH(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -1136,13 +1233,13 @@ void iSH(u32 instr) {
         return raiseException(Exception::StoreError);
     }
 
-    if (cop0::isCacheIsolated()) return;
+    if (cop0::isCacheIsolated()) return icache::store(addr);
 
     write16(addr, data);
 }
 
 /* Shift Left Logical */
-void iSLL(u32 instr) {
+HANDLER void iSLL(u32 instr) {
     const auto rd = getRd(instr);
     const auto rt = getRt(instr);
 
@@ -1160,7 +1257,7 @@ void iSLL(u32 instr) {
 }
 
 /* Shift Left Logical Variable */
-void iSLLV(u32 instr) {
+HANDLER void iSLLV(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -1173,7 +1270,7 @@ void iSLLV(u32 instr) {
 }
 
 /* Set on Less Than */
-void iSLT(u32 instr) {
+HANDLER void iSLT(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -1186,7 +1283,7 @@ void iSLT(u32 instr) {
 }
 
 /* Set on Less Than Immediate */
-void iSLTI(u32 instr) {
+HANDLER void iSLTI(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -1200,7 +1297,7 @@ void iSLTI(u32 instr) {
 }
 
 /* Set on Less Than Immediate Unsigned */
-void iSLTIU(u32 instr) {
+HANDLER void iSLTIU(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -1214,7 +1311,7 @@ void iSLTIU(u32 instr) {
 }
 
 /* Set on Less Than Unsigned */
-void iSLTU(u32 instr) {
+HANDLER void iSLTU(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -1227,7 +1324,7 @@ void iSLTU(u32 instr) {
 }
 
 /* Shift Right Arithmetic */
-void iSRA(u32 instr) {
+HANDLER void iSRA(u32 instr) {
     const auto rd = getRd(instr);
     const auto rt = getRt(instr);
 
@@ -1241,7 +1338,7 @@ void iSRA(u32 instr) {
 }
 
 /* Shift Right Arithmetic Variable */
-void iSRAV(u32 instr) {
+HANDLER void iSRAV(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -1254,7 +1351,7 @@ void iSRAV(u32 instr) {
 }
 
 /* Shift Right Logical */
-void iSRL(u32 instr) {
+HANDLER void iSRL(u32 instr) {
     const auto rd = getRd(instr);
     const auto rt = getRt(instr);
 
@@ -1268,7 +1365,7 @@ void iSRL(u32 instr) {
 }
 
 /* Shift Right Logical Variable */
-void iSRLV(u32 instr) {
+HANDLER void iSRLV(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -1281,7 +1378,7 @@ void iSRLV(u32 instr) {
 }
 
 /* SUBtract */
-void iSUB(u32 instr) {
+HANDLER void iSUB(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -1306,7 +1403,7 @@ void iSUB(u32 instr) {
 }
 
 /* SUBtract Unsigned */
-void iSUBU(u32 instr) {
+HANDLER void iSUBU(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -1319,7 +1416,7 @@ void iSUBU(u32 instr) {
 }
 
 /* Store Word */
-void iSW(u32 instr) {
+HANDLER void iSW(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -1341,13 +1438,13 @@ void iSW(u32 instr) {
         return raiseException(Exception::StoreError);
     }
 
-    if (cop0::isCacheIsolated()) return;
+    if (cop0::isCacheIsolated()) return icache::store(addr);
 
     write32(addr, data);
 }
 
 /* Store Word Coprocessor */
-void iSWC(int copN, u32 instr) {
+HANDLER void iSWC(int copN, u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -1378,13 +1475,13 @@ void iSWC(int copN, u32 instr) {
         return raiseException(Exception::StoreError);
     }
 
-    if (cop0::isCacheIsolated()) return;
+    if (cop0::isCacheIsolated()) return icache::store(addr);
 
     write32(addr, data);
 }
 
 /* Store Word Left */
-void iSWL(u32 instr) {
+HANDLER void iSWL(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -1405,7 +1502,7 @@ void iSWL(u32 instr) {
 }
 
 /* Store Word Right */
-void iSWR(u32 instr) {
+HANDLER void iSWR(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -1426,7 +1523,7 @@ void iSWR(u32 instr) {
 }
 
 /* SYStem CALL */
-void iSYSCALL() {
+HANDLER void iSYSCALL() {
     if (doDisasm) {
         std::printf("[CPU       ] SYSCALL\n");
     }
@@ -1435,7 +1532,7 @@ void iSYSCALL() {
 }
 
 /* XOR */
-void iXOR(u32 instr) {
+HANDLER void iXOR(u32 instr) {
     const auto rd = getRd(instr);
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
@@ -1448,7 +1545,7 @@ void iXOR(u32 instr) {
 }
 
 /* XOR Immediate */
-void iXORI(u32 instr) {
+HANDLER void iXORI(u32 instr) {
     const auto rs = getRs(instr);
     const auto rt = getRt(instr);
 
@@ -1612,8 +1709,145 @@ void decodeInstr(u32 instr) {
     }
 }
 
-void init() {
-    std::memset(&regs, 0, 34 * sizeof(u32));
+/* Returns the pre-decode entry of an instruction address, NULL if the address isn't in RAM or BIOS */
+u8 *getFusionEntry(u32 addr) {
+    addr &= 0x1FFFFFFF;
+
+    if (addr < (4 * RAM_SIZE)) return &ramFusion[(addr & (RAM_SIZE - 1)) >> 2]; // RAM is mirrored 4 times
+
+    if ((addr >= 0x1FC00000) && (addr < 0x1FC80000)) return &biosFusion[(addr - 0x1FC00000) >> 2];
+
+    return NULL;
+}
+
+/* Checks if the instruction at addr and its successor form a superinstruction */
+Fusion detectFusion(u32 addr) {
+    const auto phys = addr & 0x1FFFFFFF;
+
+    /* Don't fuse across the BIOS function hooks or the end of RAM/BIOS */
+    if ((phys < 0x100) || ((phys & (RAM_SIZE - 1)) == (RAM_SIZE - 4)) || (phys == 0x1FC7FFFC)) return Fusion::None;
+
+    const auto instr0 = bus::readCode32(phys & ~3);
+    const auto instr1 = bus::readCode32((phys & ~3) + 4);
+
+    const auto opcode0 = getOpcode(instr0);
+    const auto opcode1 = getOpcode(instr1);
+
+    if (opcode0 == Opcode::LUI) {
+        const auto rt = getRt(instr0);
+
+        if ((rt == CPUReg::R0) || (getRs(instr1) != rt)) return Fusion::None;
+
+        switch (opcode1) {
+            case Opcode::ORI  : return Fusion::LUIORI;
+            case Opcode::ADDIU: return Fusion::LUIADDIU;
+            case Opcode::LW   : return Fusion::LUILW;
+            case Opcode::SW   : return Fusion::LUISW;
+            default: return Fusion::None;
+        }
+    }
+
+    if ((opcode0 == Opcode::ADDIU) && ((opcode1 == Opcode::BEQ) || (opcode1 == Opcode::BNE))) return Fusion::ADDIUBR;
+
+    return Fusion::None;
+}
+
+/* Discards pre-decoded pairs that overlap an overwritten RAM range */
+void invalidateFusion(u32 addr, u32 size) {
+    const auto first = (addr >> 2) ? (addr >> 2) - 1 : 0; // Pair starting in the previous word
+
+    std::memset(&ramFusion[first], 0, (addr >> 2) + (size >> 2) - first);
+}
+
+/* Returns the superinstruction starting at addr */
+Fusion getFusion(u32 addr) {
+    auto entry = getFusionEntry(addr);
+
+    if (!entry) return Fusion::None;
+
+    if (*entry == Fusion::Unknown) {
+        *entry = detectFusion(addr);
+
+        /* Both words of a pair are decoded code */
+        if ((addr & 0x1FFFFFFF) < (4 * RAM_SIZE)) {
+            smc::markCode(addr);
+            smc::markCode(addr + 4);
+        }
+    }
+
+    return (Fusion)*entry;
+}
+
+/* Executes a fused instruction pair in one go, the first instruction is never in a delay slot */
+void doFused(Fusion fusion) {
+    const auto instr0 = icache::fetch(cpc);
+    const auto instr1 = icache::fetch(cpc + 4);
+
+    /* Skip the first instruction, the second one is the current instruction from now on */
+    cpc += 4;
+    pc  += 8;
+    npc += 8;
+
+    if (hotspot::enabled) hotspot::count(cpc);
+
+    switch (fusion) {
+        case Fusion::LUIORI:
+        case Fusion::LUIADDIU:
+            {
+                const auto rt0 = getRt(instr0);
+                const auto rt1 = getRt(instr1);
+
+                const auto hi = getImm(instr0) << 16;
+                const auto lo = (fusion == Fusion::LUIORI) ? getImm(instr1) : (u32)(i16)getImm(instr1);
+
+                /* The LUI result is dead if both instructions write the same register */
+                if (rt0 != rt1) regs[rt0] = hi;
+
+                set(rt1, (fusion == Fusion::LUIORI) ? (hi | lo) : (hi + lo));
+            }
+            break;
+        case Fusion::LUILW:
+            regs[getRt(instr0)] = getImm(instr0) << 16;
+
+            iLW(instr1);
+            break;
+        case Fusion::LUISW:
+            regs[getRt(instr0)] = getImm(instr0) << 16;
+
+            iSW(instr1);
+            break;
+        case Fusion::ADDIUBR:
+            iADDIU(instr0);
+
+            if (getOpcode(instr1) == Opcode::BEQ) {
+                iBEQ(instr1);
+            } else {
+                iBNE(instr1);
+            }
+            break;
+        default:
+            std::printf("[CPU       ] Invalid superinstruction %d @ 0x%08X\n", fusion, cpc - 4);
+
+            exit(0);
+    }
+}
+
+void init(const char *core) {
+    std::memset(&regs, 0, sizeof(regs));
+
+    if (core && !std::strcmp(core, "threaded")) {
+#ifdef __GNUC__
+        useThreaded = true;
+#else
+        std::printf("[CPU       ] Threaded interpreter not supported by this compiler\n");
+#endif
+    } else if (core && !std::strcmp(core, "ir")) {
+        useIR = true;
+    } else if (core && std::strcmp(core, "switch")) {
+        std::printf("[CPU       ] Unknown interpreter \"%s\" (switch, threaded, ir)\n", core);
+
+        exit(0);
+    }
 
     // Set program counter to reset vector
     setPC(RESET_VECTOR);
@@ -1621,36 +1855,237 @@ void init() {
     // Initialize coprocessors
     cop0::init();
 
+    smc::init();
+    icache::init();
+
+    smc::addInvalidateFunc(invalidateFusion);
+
+    if (useIR) ir::init();
+
     std::printf("[CPU       ] Init OK\n");
 }
 
-void step(i64 c) {
-    for (int i = c; i != 0; i--) {
-        cpc = pc; // Save current PC
+/* Per-instruction bookkeeping, returns true if a fused instruction pair was executed (consumes one more instruction) */
+HANDLER bool beginInstr() {
+    cpc = pc; // Save current PC
 
-        // Advance delay slot helper
-        inDelaySlot[0] = inDelaySlot[1];
-        inDelaySlot[1] = false;
+    cycles--;
 
-        /* Hook into BIOS functions */
-        if ((cpc == 0xA0) || (cpc == 0xB0) || (cpc == 0xC0)) {
-            /* Get BIOS function */
-            const auto funct = regs[CPUReg::T1];
+    // Advance delay slot helper
+    inDelaySlot[0] = inDelaySlot[1];
+    inDelaySlot[1] = false;
 
-            if ((cpc == 0xA0) && (funct == 0x40)) {
-                std::printf("[CPU        ] SystemErrorUnresolvedException()\n"); // Bad.
+    advanceLoadDelay();
 
-                exit(0);
-            } else if ((cpc == 0xB0) && (funct == 0x3D)) {
-                /* putc */
-                std::printf("%c", (char)regs[CPUReg::A0]);
-            }
+    /* Hook into BIOS functions */
+    if ((cpc == 0xA0) || (cpc == 0xB0) || (cpc == 0xC0)) {
+        /* Get BIOS function */
+        const auto funct = regs[CPUReg::T1];
+
+        if ((cpc == 0xA0) && (funct == 0x40)) {
+            std::printf("[CPU        ] SystemErrorUnresolvedException()\n"); // Bad.
+
+            exit(0);
+        } else if ((cpc == 0xB0) && (funct == 0x3D)) {
+            /* putc */
+            std::printf("%c", (char)regs[CPUReg::A0]);
+        }
+    }
+
+    if (hotspot::enabled) hotspot::count(cpc);
+
+    /* Both instructions of a pair have to run in this time slice, pairs skip the load delay bookkeeping in between */
+    if ((cycles > 0) && !inDelaySlot[0] && (loadDelay[0].idx == LOAD_DUMMY)) {
+        const auto fusion = getFusion(cpc);
+
+        if (fusion != Fusion::None) {
+            cycles--;
+
+            doFused(fusion);
+
+            return true;
         }
+    }
+
+    return false;
+}
+
+/* Switch-based interpreter */
+void stepSwitch() {
+    while (cycles > 0) {
+        if (beginInstr()) continue;
 
         decodeInstr(fetchInstr());
     }
 }
 
+/* Block recompiler, falls back to the interpreter for code it can't translate */
+void stepIR() {
+    while (cycles > 0) {
+        /* Blocks never start in a delay slot */
+        if (!inDelaySlot[1] && !hotspot::enabled) {
+            if (ir::run(cycles)) continue;
+        }
+
+        if (beginInstr()) continue;
+
+        decodeInstr(fetchInstr());
+    }
+}
+
+#ifdef __GNUC__
+/* Direct-threaded interpreter, every handler ends with its own indirect jump to the next one */
+void stepThreaded() {
+    static void *opTable[64], *specialTable[64];
+
+    static bool isTableInit = false;
+
+    if (!isTableInit) {
+        /* Everything not in the tables goes through decodeInstr(), which also reports unhandled instructions */
+        for (int i = 0; i < 64; i++) opTable[i] = specialTable[i] = &&lDecode;
+
+        opTable[Opcode::SPECIAL] = &&lSPECIAL;
+        opTable[Opcode::J      ] = &&lJ;
+        opTable[Opcode::JAL    ] = &&lJAL;
+        opTable[Opcode::BEQ    ] = &&lBEQ;
+        opTable[Opcode::BNE    ] = &&lBNE;
+        opTable[Opcode::BLEZ   ] = &&lBLEZ;
+        opTable[Opcode::BGTZ   ] = &&lBGTZ;
+        opTable[Opcode::ADDI   ] = &&lADDI;
+        opTable[Opcode::ADDIU  ] = &&lADDIU;
+        opTable[Opcode::SLTI   ] = &&lSLTI;
+        opTable[Opcode::SLTIU  ] = &&lSLTIU;
+        opTable[Opcode::ANDI   ] = &&lANDI;
+        opTable[Opcode::ORI    ] = &&lORI;
+        opTable[Opcode::XORI   ] = &&lXORI;
+        opTable[Opcode::LUI    ] = &&lLUI;
+        opTable[Opcode::LB     ] = &&lLB;
+        opTable[Opcode::LH     ] = &&lLH;
+        opTable[Opcode::LWL    ] = &&lLWL;
+        opTable[Opcode::LW     ] = &&lLW;
+        opTable[Opcode::LBU    ] = &&lLBU;
+        opTable[Opcode::LHU    ] = &&lLHU;
+        opTable[Opcode::LWR    ] = &&lLWR;
+        opTable[Opcode::SB     ] = &&lSB;
+        opTable[Opcode::SH     ] = &&lSH;
+        opTable[Opcode::SWL    ] = &&lSWL;
+        opTable[Opcode::SW     ] = &&lSW;
+        opTable[Opcode::SWR    ] = &&lSWR;
+        opTable[Opcode::LWC2   ] = &&lLWC2;
+        opTable[Opcode::SWC2   ] = &&lSWC2;
+
+        specialTable[SPECIALOpcode::SLL    ] = &&lSLL;
+        specialTable[SPECIALOpcode::SRL    ] = &&lSRL;
+        specialTable[SPECIALOpcode::SRA    ] = &&lSRA;
+        specialTable[SPECIALOpcode::SLLV   ] = &&lSLLV;
+        specialTable[SPECIALOpcode::SRLV   ] = &&lSRLV;
+        specialTable[SPECIALOpcode::SRAV   ] = &&lSRAV;
+        specialTable[SPECIALOpcode::JR     ] = &&lJR;
+        specialTable[SPECIALOpcode::JALR   ] = &&lJALR;
+        specialTable[SPECIALOpcode::SYSCALL] = &&lSYSCALL;
+        specialTable[SPECIALOpcode::BREAK  ] = &&lBREAK;
+        specialTable[SPECIALOpcode::MFHI   ] = &&lMFHI;
+        specialTable[SPECIALOpcode::MTHI   ] = &&lMTHI;
+        specialTable[SPECIALOpcode::MFLO   ] = &&lMFLO;
+        specialTable[SPECIALOpcode::MTLO   ] = &&lMTLO;
+        specialTable[SPECIALOpcode::MULT   ] = &&lMULT;
+        specialTable[SPECIALOpcode::MULTU  ] = &&lMULTU;
+        specialTable[SPECIALOpcode::DIV    ] = &&lDIV;
+        specialTable[SPECIALOpcode::DIVU   ] = &&lDIVU;
+        specialTable[SPECIALOpcode::ADD    ] = &&lADD;
+        specialTable[SPECIALOpcode::ADDU   ] = &&lADDU;
+        specialTable[SPECIALOpcode::SUB    ] = &&lSUB;
+        specialTable[SPECIALOpcode::SUBU   ] = &&lSUBU;
+        specialTable[SPECIALOpcode::AND    ] = &&lAND;
+        specialTable[SPECIALOpcode::OR     ] = &&lOR;
+        specialTable[SPECIALOpcode::XOR    ] = &&lXOR;
+        specialTable[SPECIALOpcode::NOR    ] = &&lNOR;
+        specialTable[SPECIALOpcode::SLT    ] = &&lSLT;
+        specialTable[SPECIALOpcode::SLTU   ] = &&lSLTU;
+
+        isTableInit = true;
+    }
+
+    u32 instr;
+
+/* Fetches the next instruction and jumps to its handler */
+#define DISPATCH()                          \
+    do {                                    \
+        do {                                \
+            if (cycles <= 0) return;        \
+        } while (beginInstr());             \
+        instr = fetchInstr();               \
+        goto *opTable[getOpcode(instr)];    \
+    } while (0)
+
+    DISPATCH();
+
+lSPECIAL: goto *specialTable[getFunct(instr)];
+lDecode : decodeInstr(instr); DISPATCH();
+
+lJ      : iJ(instr); DISPATCH();
+lJAL    : iJAL(instr); DISPATCH();
+lBEQ    : iBEQ(instr); DISPATCH();
+lBNE    : iBNE(instr); DISPATCH();
+lBLEZ   : iBLEZ(instr); DISPATCH();
+lBGTZ   : iBGTZ(instr); DISPATCH();
+lADDI   : iADDI(instr); DISPATCH();
+lADDIU  : iADDIU(instr); DISPATCH();
+lSLTI   : iSLTI(instr); DISPATCH();
+lSLTIU  : iSLTIU(instr); DISPATCH();
+lANDI   : iANDI(instr); DISPATCH();
+lORI    : iORI(instr); DISPATCH();
+lXORI   : iXORI(instr); DISPATCH();
+lLUI    : iLUI(instr); DISPATCH();
+lLB     : iLB(instr); DISPATCH();
+lLH     : iLH(instr); DISPATCH();
+lLWL    : iLWL(instr); DISPATCH();
+lLW     : iLW(instr); DISPATCH();
+lLBU    : iLBU(instr); DISPATCH();
+lLHU    : iLHU(instr); DISPATCH();
+lLWR    : iLWR(instr); DISPATCH();
+lSB     : iSB(instr); DISPATCH();
+lSH     : iSH(instr); DISPATCH();
+lSWL    : iSWL(instr); DISPATCH();
+lSW     : iSW(instr); DISPATCH();
+lSWR    : iSWR(instr); DISPATCH();
+lLWC2   : iLWC(2, instr); DISPATCH();
+lSWC2   : iSWC(2, instr); DISPATCH();
+
+lSLL    : iSLL(instr); DISPATCH();
+lSRL    : iSRL(instr); DISPATCH();
+lSRA    : iSRA(instr); DISPATCH();
+lSLLV   : iSLLV(instr); DISPATCH();
+lSRLV   : iSRLV(instr); DISPATCH();
+lSRAV   : iSRAV(instr); DISPATCH();
+lJR     : iJR(instr); DISPATCH();
+lJALR   : iJALR(instr); DISPATCH();
+lSYSCALL: iSYSCALL(); DISPATCH();
+lBREAK  : iBREAK(); DISPATCH();
+lMFHI   : iMFHI(instr); DISPATCH();
+lMTHI   : iMTHI(instr); DISPATCH();
+lMFLO   : iMFLO(instr); DISPATCH();
+lMTLO   : iMTLO(instr); DISPATCH();
+lMULT   : iMULT(instr); DISPATCH();
+lMULTU  : iMULTU(instr); DISPATCH();
+lDIV    : iDIV(instr); DISPATCH();
+lDIVU   : iDIVU(instr); DISPATCH();
+lADD    : iADD(instr); DISPATCH();
+lADDU   : iADDU(instr); DISPATCH();
+lSUB    : iSUB(instr); DISPATCH();
+lSUBU   : iSUBU(instr); DISPATCH();
+lAND    : iAND(instr); DISPATCH();
+lOR     : iOR(instr); DISPATCH();
+lXOR    : iXOR(instr); DISPATCH();
+lNOR    : iNOR(instr); DISPATCH();
+lSLT    : iSLT(instr); DISPATCH();
+lSLTU   : iSLTU(instr); DISPATCH();
+
+#undef DISPATCH
+}
+#endif
+
+/* Takes an interrupt at an instruction boundary */
 void doInterrupt() {
     /* Set CPC and advance delay slot */
     cpc = pc;
@@ -1658,7 +2093,61 @@ void doInterrupt() {
     inDelaySlot[0] = inDelaySlot[1];
     inDelaySlot[1] = false;
 
+    advanceLoadDelay();
+
     raiseException(Exception::Interrupt);
 }
 
+/* Runs the CPU for c cycles (plus the overshoot of the last instruction), returns the number of executed instructions */
+i64 step(i64 c) {
+    cycles   += c;
+    timeBase += c;
+
+    const auto startCycles = cycles;
+    const auto startStalls = stallCycles;
+
+    while (true) {
+        if (isInterruptRequested) {
+            isInterruptRequested = false;
+
+            /* Resume the interrupted time slice */
+            cycles   += deferredCycles;
+            timeBase += deferredCycles;
+
+            deferredCycles = 0;
+
+            if (cop0::isInterruptPending()) doInterrupt();
+        }
+
+        if (cycles <= 0) break;
+
+        if (useIR) {
+            stepIR();
+#ifdef __GNUC__
+        } else if (useThreaded) {
+            stepThreaded();
+#endif
+        } else {
+            stepSwitch();
+        }
+
+        if (!isInterruptRequested) break;
+    }
+
+    return (startCycles - cycles) - (stallCycles - startStalls);
+}
+
+/* Ends the time slice after the current instruction, the interrupt is taken before the next one.
+ * The stepping loops check the cycle budget anyway, so interrupts cost nothing per instruction
+ */
+void requestInterrupt() {
+    isInterruptRequested = true;
+
+    /* Keep CPU time continuous */
+    deferredCycles += cycles;
+    timeBase       -= cycles;
+
+    cycles = 0;
+}
+
 }
@@ -9,9 +9,58 @@
 
 namespace ps::cpu {
 
-void init();
-void step(i64 c);
+constexpr u32 RAM_SIZE = 0x200000;
 
-void doInterrupt();
+void init(const char *core);
+i64 step(i64 c);
+
+void requestInterrupt();
+
+i64 getTime();
+
+/* --- Interpreter state, shared with the recompiler --- */
+
+constexpr u32 LOAD_DUMMY = 34; // Target of empty load delay slots
+
+/* Pending load */
+struct LoadDelay {
+    u32 idx, data;
+};
+
+extern u32 regs[35];
+
+extern u32 pc, cpc, npc;
+
+extern bool inDelaySlot[2];
+
+extern LoadDelay loadDelay[2];
+
+extern bool isInterruptRequested; // Set until the time slice ends
+
+extern i64 cycles;      // Cycle budget of the current time slice, every instruction costs at least one cycle
+extern i64 stallCycles; // Cycles charged on top of that
+
+/* Charges extra cycles to the current instruction */
+inline void addStall(i64 n) {
+    cycles      -= n;
+    stallCycles += n;
+}
+
+/* Commits the load of the previous instruction, the load of the current instruction becomes visible after the next one */
+inline void advanceLoadDelay() {
+    regs[loadDelay[0].idx] = loadDelay[0].data;
+
+    loadDelay[0] = loadDelay[1];
+    loadDelay[1] = LoadDelay{LOAD_DUMMY, 0};
+}
+
+/* Sets a register through the load delay slot */
+inline void setLoad(u32 idx, u32 data) {
+    if (loadDelay[0].idx == idx) loadDelay[0].idx = LOAD_DUMMY; // The newer load wins
+
+    loadDelay[1] = LoadDelay{(idx) ? idx : LOAD_DUMMY, data};
+}
+
+void decodeInstr(u32 instr);
 
 }
@@ -5,9 +5,13 @@
 
 #include "gte.hpp"
 
+#include <array>
 #include <bit>
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
+
+#include "../profiler.hpp"
 
 namespace ps::cpu::gte {
 
@@ -36,6 +40,25 @@ enum Opcode {
     NCCT  = 0x3F,
 };
 
+/* Hardware cycle counts of the implemented commands (only used for profiling) */
+constexpr auto CMD_CYCLES = [] {
+    std::array<u8, 64> cycles{};
+
+    cycles[RTPS ] = 15;
+    cycles[NCLIP] =  8;
+    cycles[MVMVA] =  8;
+    cycles[NCDS ] = 19;
+    cycles[SQR  ] =  5;
+    cycles[AVSZ3] =  5;
+    cycles[AVSZ4] =  6;
+    cycles[RTPT ] = 23;
+    cycles[GPF  ] =  5;
+    cycles[GPL  ] =  5;
+    cycles[NCCT ] = 39;
+
+    return cycles;
+}();
+
 /* --- GTE registers --- */
 
 enum GTEReg {
@@ -1019,8 +1042,12 @@ void iSQR(u32 cmd) {
 }
 
 void doCmd(u32 cmd) {
+    PROFILE_SCOPE(profiler::Zone::GTE);
+
     const auto opcode = cmd & 0x3F;
 
+    PROFILE_CYCLES(profiler::Zone::GTE, CMD_CYCLES[opcode]);
+
     switch (opcode) {
         case Opcode::RTPS : iRTPS(cmd); break;
         case Opcode::NCLIP: iNCLIP(); break;
@@ -0,0 +1,264 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "hotspot.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../bus/bus.hpp"
+
+namespace ps::cpu::hotspot {
+
+/* --- Hot spot profiler constants --- */
+
+constexpr int MAX_FUNCTIONS = 32;
+constexpr int MAX_LOOPS     = 32;
+
+/* Function entry point, either from the symbol map or from a call target */
+struct Function {
+    std::string name;
+
+    u64 calls;
+};
+
+/* Backward branch and its body */
+struct Loop {
+    u32 start, end; // Branch target, branch address
+    u64 instrs, iterations;
+};
+
+bool enabled = false;
+
+u64 ramCounts[RAM_SIZE >> 2];
+u64 biosCounts[BIOS_SIZE >> 2];
+
+std::unordered_map<u32, Function> functions; // Indexed by physical address
+
+const char *reportPath = NULL;
+
+/* Returns execution count of a physical address */
+u64 getCount(u32 addr) {
+    if (addr < RAM_SIZE) return ramCounts[addr >> 2];
+
+    if ((addr >= BIOS_BASE) && (addr < (BIOS_BASE + BIOS_SIZE))) return biosCounts[(addr - BIOS_BASE) >> 2];
+
+    return 0;
+}
+
+/* Returns KSEG0 (RAM) or KSEG1 (BIOS) address of a physical address */
+u32 toVirtual(u32 addr) {
+    return (addr < RAM_SIZE) ? (0x80000000 | addr) : (0xA0000000 | addr);
+}
+
+/* Normalizes a virtual address, removes RAM mirrors */
+u32 toPhysical(u32 addr) {
+    addr &= 0x1FFFFFFF;
+
+    if (addr < (4 * RAM_SIZE)) addr &= RAM_SIZE - 1;
+
+    return addr;
+}
+
+/* Returns branch target if instruction is a backward branch or jump, 0 otherwise */
+u32 getBackwardTarget(u32 addr, u32 instr) {
+    const auto opcode = instr >> 26;
+
+    u32 target;
+
+    switch (opcode) {
+        case 0x01: // REGIMM
+        case 0x04: // BEQ
+        case 0x05: // BNE
+        case 0x06: // BLEZ
+        case 0x07: // BGTZ
+            target = addr + 4 + ((u32)(i16)instr << 2);
+            break;
+        case 0x02: // J
+            target = ((addr + 4) & 0xF0000000) | ((instr & 0x3FFFFFF) << 2);
+            break;
+        default:
+            return 0;
+    }
+
+    target = toPhysical(target);
+
+    /* Loop body must be in the same region */
+    if ((target > addr) || ((target < RAM_SIZE) != (addr < RAM_SIZE))) return 0;
+
+    return target;
+}
+
+/* Loads a symbol map ("ADDRESS NAME" per line) */
+void loadSymbols(const char *path) {
+    auto file = std::fopen(path, "r");
+
+    if (!file) {
+        std::printf("[Hotspot   ] Unable to open symbol map \"%s\"\n", path);
+
+        exit(0);
+    }
+
+    char line[512], name[256];
+
+    int symbolCount = 0;
+
+    while (std::fgets(line, sizeof(line), file)) {
+        unsigned int addr;
+
+        if (std::sscanf(line, "%x %255s", &addr, name) != 2) continue;
+
+        functions[toPhysical(addr)] = Function{name, 0};
+
+        symbolCount++;
+    }
+
+    std::fclose(file);
+
+    std::printf("[Hotspot   ] Loaded %d symbols from \"%s\"\n", symbolCount, path);
+}
+
+/* Writes hot functions and loops to the report file */
+void report() {
+    auto file = std::fopen(reportPath, "w");
+
+    if (!file) {
+        std::printf("[Hotspot   ] Unable to open file \"%s\"\n", reportPath);
+
+        return;
+    }
+
+    /* Collect all executed addresses */
+    std::vector<u32> addrs;
+
+    u64 total = 0;
+
+    for (u32 i = 0; i < (RAM_SIZE >> 2); i++) {
+        if (ramCounts[i]) { addrs.push_back(i << 2); total += ramCounts[i]; }
+    }
+
+    for (u32 i = 0; i < (BIOS_SIZE >> 2); i++) {
+        if (biosCounts[i]) { addrs.push_back(BIOS_BASE + (i << 2)); total += biosCounts[i]; }
+    }
+
+    std::fprintf(file, "Instructions executed: %llu\n\n", (unsigned long long)total);
+
+    if (!total) return (void)std::fclose(file);
+
+    /* Attribute every address to the closest preceding function entry */
+    std::vector<u32> entries;
+
+    for (auto &f : functions) entries.push_back(f.first);
+
+    std::sort(entries.begin(), entries.end());
+
+    std::unordered_map<u32, u64> selfCounts;
+
+    for (auto addr : addrs) {
+        auto entry = std::upper_bound(entries.begin(), entries.end(), addr);
+
+        u32 func = 0xFFFFFFFF; // Unknown
+
+        if ((entry != entries.begin()) && ((*(entry - 1) < RAM_SIZE) == (addr < RAM_SIZE))) func = *(entry - 1);
+
+        selfCounts[func] += getCount(addr);
+    }
+
+    std::vector<std::pair<u32, u64>> hotFunctions(selfCounts.begin(), selfCounts.end());
+
+    std::sort(hotFunctions.begin(), hotFunctions.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+
+    if ((int)hotFunctions.size() > MAX_FUNCTIONS) hotFunctions.resize(MAX_FUNCTIONS);
+
+    std::fprintf(file, "Hottest functions:\n");
+    std::fprintf(file, "  %-10s  %14s  %7s  %10s  %s\n", "Address", "Instructions", "Share", "Calls", "Name");
+
+    for (auto &[func, count] : hotFunctions) {
+        if (func == 0xFFFFFFFF) {
+            std::fprintf(file, "  %-10s  %14llu  %6.2f%%  %10s  %s\n", "?", (unsigned long long)count, 100.0 * count / total, "-", "(unknown)");
+
+            continue;
+        }
+
+        const auto &f = functions[func];
+
+        std::fprintf(
+            file, "  0x%08X  %14llu  %6.2f%%  %10llu  %s\n", toVirtual(func), (unsigned long long)count,
+            100.0 * count / total, (unsigned long long)f.calls, f.name.empty() ? "-" : f.name.c_str()
+        );
+    }
+
+    /* Find loops, i.e. executed backward branches */
+    std::vector<Loop> loops;
+
+    for (auto addr : addrs) {
+        const auto target = getBackwardTarget(addr, bus::readCode32(addr));
+
+        if (!target) continue;
+
+        Loop loop{target, addr, 0, getCount(addr)};
+
+        for (u32 i = target; i <= (addr + 4); i += 4) loop.instrs += getCount(i); // Includes delay slot
+
+        loops.push_back(loop);
+    }
+
+    std::sort(loops.begin(), loops.end(), [](const auto &a, const auto &b) { return a.instrs > b.instrs; });
+
+    if ((int)loops.size() > MAX_LOOPS) loops.resize(MAX_LOOPS);
+
+    std::fprintf(file, "\nHottest loops:\n");
+    std::fprintf(file, "  %-23s  %14s  %7s  %12s  %s\n", "Range", "Instructions", "Share", "Iterations", "Function");
+
+    for (auto &loop : loops) {
+        auto entry = std::upper_bound(entries.begin(), entries.end(), loop.start);
+
+        const char *name = "-";
+
+        if ((entry != entries.begin()) && ((*(entry - 1) < RAM_SIZE) == (loop.start < RAM_SIZE))) {
+            const auto &f = functions[*(entry - 1)];
+
+            if (!f.name.empty()) name = f.name.c_str();
+        }
+
+        std::fprintf(
+            file, "  0x%08X - 0x%08X  %14llu  %6.2f%%  %12llu  %s\n", toVirtual(loop.start), toVirtual(loop.end),
+            (unsigned long long)loop.instrs, 100.0 * loop.instrs / total, (unsigned long long)loop.iterations, name
+        );
+    }
+
+    std::fclose(file);
+
+    std::printf("[Hotspot   ] Wrote hot spot report to \"%s\"\n", reportPath);
+}
+
+void init(const char *reportPath, const char *symbolPath) {
+    if (!reportPath) {
+        if (symbolPath) std::printf("[Hotspot   ] Symbol map is only used with --hotspots\n");
+
+        return;
+    }
+
+    hotspot::reportPath = reportPath;
+
+    if (symbolPath) loadSymbols(symbolPath);
+
+    std::atexit(report);
+
+    enabled = true;
+}
+
+/* Registers a call target as function entry */
+void addCall(u32 target) {
+    auto &f = functions[toPhysical(target)];
+
+    f.calls++;
+}
+
+}
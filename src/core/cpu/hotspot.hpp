@@ -0,0 +1,39 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include "../../common/types.hpp"
+
+namespace ps::cpu::hotspot {
+
+/* --- Hot spot profiler constants --- */
+
+constexpr u32 RAM_SIZE  = 0x200000;
+constexpr u32 BIOS_BASE = 0x1FC00000;
+constexpr u32 BIOS_SIZE = 0x80000;
+
+extern bool enabled;
+
+/* Execution counts per instruction word */
+extern u64 ramCounts[RAM_SIZE >> 2];
+extern u64 biosCounts[BIOS_SIZE >> 2];
+
+void init(const char *reportPath, const char *symbolPath);
+
+void addCall(u32 target);
+
+/* Counts one executed instruction */
+inline void count(u32 addr) {
+    addr &= 0x1FFFFFFF;
+
+    if (addr < (4 * RAM_SIZE)) { // RAM is mirrored 4 times
+        ramCounts[(addr & (RAM_SIZE - 1)) >> 2]++;
+    } else if ((addr >= BIOS_BASE) && (addr < (BIOS_BASE + BIOS_SIZE))) {
+        biosCounts[(addr - BIOS_BASE) >> 2]++;
+    }
+}
+
+}
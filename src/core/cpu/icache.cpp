@@ -0,0 +1,116 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "icache.hpp"
+
+#include <cstdio>
+
+#include "smc.hpp"
+#include "../debugger.hpp"
+#include "../bus/bus.hpp"
+
+namespace ps::cpu::icache {
+
+/* --- Fetch timings (cycles per word, other regions use the MEMCTRL wait states) --- */
+
+constexpr i64 RAM_FETCH_CYCLES = 4;
+constexpr i64 RAM_BURST_CYCLES = 1; // Following words of a line refill
+
+constexpr u32 KSEG1_BASE = 0xA0000000;
+constexpr u32 RAM_LIMIT  = 0x800000; // Including mirrors
+
+constexpr u32 CACHE_ENABLE = 1 << 11; // CACHE_CONTROL.IS1
+
+Line lines[LINE_COUNT];
+
+u32 cachedLimit = 0; // Disabled after reset
+
+void invalidateLine(u32 idx) {
+    for (auto &tag : lines[idx].tag) tag = INVALID_TAG;
+}
+
+/* Keeps the cache coherent with RAM stores the emulator makes without a flush (DMA, EXE loading, self-modifying code) */
+void invalidate(u32 addr, u32 size) {
+    for (u32 i = 0; i < size; i += 16) invalidateLine(((addr + i) >> 4) & (LINE_COUNT - 1));
+}
+
+void init() {
+    for (u32 i = 0; i < LINE_COUNT; i++) invalidateLine(i);
+
+    smc::addInvalidateFunc(invalidate);
+}
+
+/* Writes CACHE_CONTROL */
+void writeControl(u32 data) {
+    cachedLimit = (data & CACHE_ENABLE) ? KSEG1_BASE : 0;
+}
+
+/* Store with isolated cache (BIOS cache flush), invalidates the indexed line */
+void store(u32 addr) {
+    invalidateLine((addr >> 4) & (LINE_COUNT - 1));
+}
+
+/* Uncached fetch or cache miss, refills the line from the missed word on */
+u32 fetchSlow(u32 addr) {
+    const auto phys = addr & 0x1FFFFFFC;
+
+    const bool isRAM = phys < RAM_LIMIT;
+
+    const auto fetchCycles = (isRAM) ? RAM_FETCH_CYCLES : (i64)bus::getReadCycles32(phys) + 1; // No bursts
+
+    /* The first cycle is part of the instruction */
+    if (addr >= cachedLimit) {
+        addStall(fetchCycles - 1);
+
+        if (debugger::isBreakpoint(phys)) debugger::reportBreakpoint(addr);
+
+        return bus::readCode32(phys);
+    }
+
+    auto &line = lines[(addr >> 4) & (LINE_COUNT - 1)];
+
+    const auto tag  = addr & TAG_MASK;
+    const auto word = (addr >> 2) & 3;
+
+    /* Valid word with a breakpoint */
+    if (line.tag[word] == (tag | BREAKPOINT_TAG)) {
+        debugger::reportBreakpoint(addr);
+
+        return line.data[word];
+    }
+
+    if ((line.tag[0] & ~BREAKPOINT_TAG) != tag) invalidateLine((addr >> 4) & (LINE_COUNT - 1));
+
+    for (u32 i = word; i < 4; i++) {
+        const auto wordAddr = (phys & ~0xF) | (i << 2);
+
+        line.tag[i]  = tag | ((debugger::isBreakpoint(wordAddr)) ? BREAKPOINT_TAG : 0);
+        line.data[i] = bus::readCode32(wordAddr);
+
+        if (isRAM) smc::markCode(wordAddr);
+    }
+
+    addStall(fetchCycles - 1 + (3 - word) * ((isRAM) ? RAM_BURST_CYCLES : fetchCycles));
+
+    if (line.tag[word] & BREAKPOINT_TAG) debugger::reportBreakpoint(addr);
+
+    return line.data[word];
+}
+
+/* Charges the fetches of count sequential instructions within one line (pre-decoded code) */
+void fetchBlock(u32 addr, u32 count) {
+    if (addr >= cachedLimit) {
+        const auto phys = addr & 0x1FFFFFFF;
+
+        const auto fetchCycles = (phys < RAM_LIMIT) ? RAM_FETCH_CYCLES : (i64)bus::getReadCycles32(phys) + 1;
+
+        return addStall(count * (fetchCycles - 1));
+    }
+
+    /* Lines are always refilled up to the end, a valid word implies that all following words are valid */
+    fetch(addr);
+}
+
+}
@@ -0,0 +1,53 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include "cpu.hpp"
+
+namespace ps::cpu::icache {
+
+/* --- Instruction cache constants --- */
+
+constexpr u32 LINE_COUNT = 256; // 4 KiB, 16-byte lines
+
+constexpr u32 TAG_MASK    = 0x1FFFF000; // Physical address bits above the line index
+constexpr u32 INVALID_TAG = 0xFFFFFFFF;
+
+constexpr u32 BREAKPOINT_TAG = 1; // Set on words with a debugger breakpoint, makes fetch() take the slow path
+
+/* Cache line, every word has its own copy of the tag (INVALID_TAG if the word isn't valid) */
+struct Line {
+    u32 tag[4];
+    u32 data[4];
+};
+
+extern Line lines[LINE_COUNT];
+
+extern u32 cachedLimit; // Fetches from addresses above this are uncached (KSEG1, KSEG2, cache disabled)
+
+void init();
+
+void writeControl(u32 data);
+
+void store(u32 addr);
+
+u32 fetchSlow(u32 addr);
+void fetchBlock(u32 addr, u32 count);
+
+/* Fetches an instruction word, charges uncached fetches and miss penalties */
+inline u32 fetch(u32 addr) {
+    if (addr >= cachedLimit) return fetchSlow(addr);
+
+    auto &line = lines[(addr >> 4) & (LINE_COUNT - 1)];
+
+    const auto word = (addr >> 2) & 3;
+
+    if (line.tag[word] != (addr & TAG_MASK)) return fetchSlow(addr);
+
+    return line.data[word];
+}
+
+}
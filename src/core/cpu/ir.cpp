@@ -0,0 +1,943 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "ir.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "cop0.hpp"
+#include "cpu.hpp"
+#include "icache.hpp"
+#include "smc.hpp"
+#include "tcache.hpp"
+#include "../debugger.hpp"
+#include "../bus/attr.hpp"
+#include "../bus/bus.hpp"
+
+namespace ps::cpu::ir {
+
+/* --- Recompiler constants --- */
+
+constexpr int MAX_BLOCK_SIZE = 32; // Instructions
+
+constexpr u32 PAGE_MASK = 0xFFF; // Blocks never cross 4 KiB pages
+
+constexpr u32 BIOS_BASE  = 0x1FC00000;
+constexpr u32 BIOS_SIZE  = 0x80000;
+constexpr u32 SPRAM_BASE = 0x1F800000;
+constexpr u32 SPRAM_SIZE = 0x400;
+
+constexpr u32 ALL_REGS = 0xFFFFFFFF;
+
+constexpr u32 CODE_PAGE_SIZE  = PAGE_MASK + 1;
+constexpr u32 CODE_PAGE_COUNT = (RAM_SIZE + BIOS_SIZE) / CODE_PAGE_SIZE; // RAM, then BIOS
+
+constexpr int MAX_PROBES = 4; // Translation cache lookups per page
+
+/* IR operations */
+enum class OpKind : u8 {
+    /* ALU operations (never trap), dst = f(rs, rt) or dst = f(rs, imm) */
+    MOVI,
+    ADDU, ADDUI,
+    SUBU,
+    AND, ANDI,
+    OR, ORI,
+    XOR, XORI,
+    NOR,
+    SLT, SLTI,
+    SLTU, SLTUI,
+    SLL, SRL, SRA, // rs is the shifted register, imm the shift amount
+    SLLV, SRLV, SRAV, // rs is the shifted register, rt the shift amount
+    /* Loads and stores with constant physical addresses (imm) */
+    LoadRAM, LoadSPRAM, LoadIO,
+    StoreRAM, StoreSPRAM, StoreIO,
+    /* Charges instruction fetches of one cache line (imm: instruction count) */
+    Fetch,
+    /* Load delay slots */
+    Advance, // Commits the load of the previous instruction
+    Cancel,  // Native writes to dst cancel a pending load to dst
+    /* Executed by the interpreter */
+    Interp,
+    Branch, // Followed by the delay slot
+};
+
+/* IR instruction */
+struct Op {
+    OpKind kind;
+
+    u8 dst, rs, rt;
+
+    u8   size; // Memory access size in bytes
+    bool isSigned;
+
+    bool isDelaySlot;
+    u8   index; // Guest instruction index in the block
+
+    u32 imm;   // Immediate, constant or physical address
+    u32 instr; // Guest instruction
+    u32 addr;  // Guest address
+};
+
+static_assert(sizeof(Op) == 20, "Ops are stored in the translation cache as is");
+
+/* Translated block */
+struct Block {
+    u32 vaddr; // Branch targets depend on the segment, so blocks are bound to a virtual address
+    u32 size;  // Guest instructions
+
+    bool hasBranch;
+    bool isValid;
+
+    std::vector<Op> ops;
+};
+
+/* Known register values during translation */
+struct Constants {
+    bool isKnown[32];
+    u32  value[32];
+
+    void forget() {
+        std::memset(isKnown, 0, sizeof(isKnown));
+
+        isKnown[0] = true;
+        value[0]   = 0;
+    }
+};
+
+Block *ramBlocks[RAM_SIZE >> 2];
+Block *biosBlocks[BIOS_SIZE >> 2];
+
+Block noBlock; // Code that can't be translated
+
+std::vector<Block *> retiredBlocks; // Invalidated blocks are freed when no block is running
+
+u8 *ram, *spram;
+
+bool useCache = false; // Cached blocks don't know about debugger breakpoints and watchpoints
+
+u8   probeCount[CODE_PAGE_COUNT];
+bool isProbed[CODE_PAGE_COUNT]; // Cleared when code in the page is overwritten
+
+/* --- Instruction fields --- */
+
+u32 getOpcode(u32 instr) { return instr >> 26; }
+u32 getFunct(u32 instr) { return instr & 0x3F; }
+u32 getShamt(u32 instr) { return (instr >> 6) & 0x1F; }
+u32 getImm(u32 instr) { return instr & 0xFFFF; }
+u32 getSImm(u32 instr) { return (u32)(i16)(instr & 0xFFFF); }
+u32 getRd(u32 instr) { return (instr >> 11) & 0x1F; }
+u32 getRs(u32 instr) { return (instr >> 21) & 0x1F; }
+u32 getRt(u32 instr) { return (instr >> 16) & 0x1F; }
+
+/* Returns true if an instruction is a branch or jump */
+bool isBranch(u32 instr) {
+    switch (getOpcode(instr)) {
+        case 0x00: return (getFunct(instr) == 0x08) || (getFunct(instr) == 0x09); // JR, JALR
+        case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: case 0x07: return true;
+        default: return false;
+    }
+}
+
+/* Returns true if an instruction may go through the load delay slot */
+bool isLoad(u32 instr) {
+    const auto opcode = getOpcode(instr);
+
+    return ((opcode >= 0x20) && (opcode <= 0x26)) || (opcode == 0x10) || (opcode == 0x12); // Loads, MFCn/CFCn
+}
+
+/* Returns true if an instruction always ends a block (exceptions, COP0 state changes) */
+bool isBlockEnd(u32 instr) {
+    switch (getOpcode(instr)) {
+        case 0x00: return (getFunct(instr) == 0x0C) || (getFunct(instr) == 0x0D); // SYSCALL, BREAK
+        case 0x10: return true; // COP0 (MTC0 changes interrupt masks and cache isolation, RFE)
+        default: return false;
+    }
+}
+
+bool isALU(OpKind kind) {
+    return kind <= OpKind::SRAV;
+}
+
+bool isRI(OpKind kind) {
+    switch (kind) {
+        case OpKind::ADDUI: case OpKind::ANDI: case OpKind::ORI: case OpKind::XORI:
+        case OpKind::SLTI: case OpKind::SLTUI:
+        case OpKind::SLL: case OpKind::SRL: case OpKind::SRA:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Operations that may leave the block, all registers have to be up to date before them */
+bool isBarrier(OpKind kind) {
+    switch (kind) {
+        case OpKind::LoadIO: case OpKind::StoreRAM: case OpKind::StoreIO:
+        case OpKind::Interp: case OpKind::Branch:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Evaluates an ALU operation at translation time */
+u32 evalALU(OpKind kind, u32 a, u32 b) {
+    switch (kind) {
+        case OpKind::ADDU : case OpKind::ADDUI: return a + b;
+        case OpKind::SUBU : return a - b;
+        case OpKind::AND  : case OpKind::ANDI : return a & b;
+        case OpKind::OR   : case OpKind::ORI  : return a | b;
+        case OpKind::XOR  : case OpKind::XORI : return a ^ b;
+        case OpKind::NOR  : return ~(a | b);
+        case OpKind::SLT  : case OpKind::SLTI : return (i32)a < (i32)b;
+        case OpKind::SLTU : case OpKind::SLTUI: return a < b;
+        case OpKind::SLL  : case OpKind::SLLV : return a << (b & 0x1F);
+        case OpKind::SRL  : case OpKind::SRLV : return a >> (b & 0x1F);
+        case OpKind::SRA  : case OpKind::SRAV : return (i32)a >> (b & 0x1F);
+        default:
+            std::printf("[IR        ] Invalid ALU operation %d\n", (int)kind);
+
+            exit(0);
+    }
+}
+
+/* Returns the register-immediate form of a register-register operation, MOVI if there is none */
+OpKind getRIForm(OpKind kind) {
+    switch (kind) {
+        case OpKind::ADDU: return OpKind::ADDUI;
+        case OpKind::AND : return OpKind::ANDI;
+        case OpKind::OR  : return OpKind::ORI;
+        case OpKind::XOR : return OpKind::XORI;
+        case OpKind::SLT : return OpKind::SLTI;
+        case OpKind::SLTU: return OpKind::SLTUI;
+        case OpKind::SLLV: return OpKind::SLL;
+        case OpKind::SRLV: return OpKind::SRL;
+        case OpKind::SRAV: return OpKind::SRA;
+        default: return OpKind::MOVI;
+    }
+}
+
+/* --- Translation --- */
+
+/* Emits an ALU operation, folds constant operands */
+void emitALU(Block &block, Op op, OpKind kind, u32 dst, u32 rs, u32 rt, u32 imm, Constants &c) {
+    if (dst == 0) return; // No side effects
+
+    const bool isImm = isRI(kind);
+
+    /* Constant result */
+    if (c.isKnown[rs] && (isImm || c.isKnown[rt])) {
+        const auto value = evalALU(kind, c.value[rs], isImm ? imm : c.value[rt]);
+
+        op.kind = OpKind::MOVI;
+        op.dst  = dst;
+        op.imm  = value;
+
+        block.ops.push_back(op);
+
+        c.isKnown[dst] = true;
+        c.value[dst]   = value;
+
+        return;
+    }
+
+    if (!isImm) {
+        /* Commutative operations with a constant first operand */
+        const bool isCommutative = (kind == OpKind::ADDU) || (kind == OpKind::AND) || (kind == OpKind::OR) || (kind == OpKind::XOR);
+
+        if (isCommutative && c.isKnown[rs]) std::swap(rs, rt);
+
+        if (c.isKnown[rt]) {
+            if (kind == OpKind::SUBU) {
+                kind = OpKind::ADDUI;
+                imm  = -c.value[rt];
+            } else if (getRIForm(kind) != OpKind::MOVI) {
+                const bool isShift = (kind == OpKind::SLLV) || (kind == OpKind::SRLV) || (kind == OpKind::SRAV);
+
+                kind = getRIForm(kind);
+                imm  = (isShift) ? (c.value[rt] & 0x1F) : c.value[rt]; // Only the low 5 bits of the shift amount are used
+            }
+        }
+    }
+
+    op.kind = kind;
+    op.dst  = dst;
+    op.rs   = rs;
+    op.rt   = rt;
+    op.imm  = imm;
+
+    block.ops.push_back(op);
+
+    c.isKnown[dst] = false;
+}
+
+/* Emits an interpreter fallback */
+void emitInterp(Block &block, Op op, Constants &c) {
+    op.kind = OpKind::Interp;
+
+    block.ops.push_back(op);
+
+    c.forget();
+}
+
+/* Emits a load or store, constant addresses are resolved to RAM, scratchpad or I/O */
+void emitMemory(Block &block, Op op, bool isStore, u32 size, bool isSigned, Constants &c) {
+    const auto rs = getRs(op.instr);
+    const auto rt = getRt(op.instr);
+
+    const auto vaddr = c.value[rs] + getSImm(op.instr);
+
+    /* Unknown or misaligned addresses (address errors) go through the interpreter */
+    if (!c.isKnown[rs] || (vaddr & (size - 1)) || (!isStore && (rt == 0))) return emitInterp(block, op, c);
+
+    const auto addr = vaddr & 0x1FFFFFFF;
+
+    /* The debugger reports the PC of watched accesses */
+    if (debugger::isWatched(addr, size, isStore)) {
+        return emitInterp(block, op, c);
+    } else if (addr < RAM_SIZE) {
+        op.kind = (isStore) ? OpKind::StoreRAM : OpKind::LoadRAM;
+        op.imm  = addr;
+    } else if ((addr >= SPRAM_BASE) && (addr < (SPRAM_BASE + SPRAM_SIZE))) {
+        op.kind = (isStore) ? OpKind::StoreSPRAM : OpKind::LoadSPRAM;
+        op.imm  = addr - SPRAM_BASE;
+    } else {
+        op.kind = (isStore) ? OpKind::StoreIO : OpKind::LoadIO;
+        op.imm  = addr;
+    }
+
+    op.rt       = rt; // Loads go through the load delay slot
+    op.size     = size;
+    op.isSigned = isSigned;
+
+    block.ops.push_back(op);
+
+    if (!isStore) c.isKnown[rt] = false;
+}
+
+/* Translates a non-branch instruction */
+void translate(Block &block, u32 instr, u32 addr, int index, bool isDelaySlot, Constants &c) {
+    Op op{};
+
+    op.instr       = instr;
+    op.addr        = addr;
+    op.index       = index;
+    op.isDelaySlot = isDelaySlot;
+
+    const auto rd = getRd(instr);
+    const auto rs = getRs(instr);
+    const auto rt = getRt(instr);
+
+    switch (getOpcode(instr)) {
+        case 0x00: // SPECIAL
+            switch (getFunct(instr)) {
+                case 0x00: return emitALU(block, op, OpKind::SLL , rd, rt, 0, getShamt(instr), c);
+                case 0x02: return emitALU(block, op, OpKind::SRL , rd, rt, 0, getShamt(instr), c);
+                case 0x03: return emitALU(block, op, OpKind::SRA , rd, rt, 0, getShamt(instr), c);
+                case 0x04: return emitALU(block, op, OpKind::SLLV, rd, rt, rs, 0, c);
+                case 0x06: return emitALU(block, op, OpKind::SRLV, rd, rt, rs, 0, c);
+                case 0x07: return emitALU(block, op, OpKind::SRAV, rd, rt, rs, 0, c);
+                case 0x21: return emitALU(block, op, OpKind::ADDU, rd, rs, rt, 0, c);
+                case 0x23: return emitALU(block, op, OpKind::SUBU, rd, rs, rt, 0, c);
+                case 0x24: return emitALU(block, op, OpKind::AND , rd, rs, rt, 0, c);
+                case 0x25: return emitALU(block, op, OpKind::OR  , rd, rs, rt, 0, c);
+                case 0x26: return emitALU(block, op, OpKind::XOR , rd, rs, rt, 0, c);
+                case 0x27: return emitALU(block, op, OpKind::NOR , rd, rs, rt, 0, c);
+                case 0x2A: return emitALU(block, op, OpKind::SLT , rd, rs, rt, 0, c);
+                case 0x2B: return emitALU(block, op, OpKind::SLTU, rd, rs, rt, 0, c);
+                default: return emitInterp(block, op, c); // Trapping arithmetic, MULT/DIV, HI/LO, SYSCALL, BREAK
+            }
+        case 0x09: return emitALU(block, op, OpKind::ADDUI, rt, rs, 0, getSImm(instr), c); // ADDIU
+        case 0x0A: return emitALU(block, op, OpKind::SLTI , rt, rs, 0, getSImm(instr), c);
+        case 0x0B: return emitALU(block, op, OpKind::SLTUI, rt, rs, 0, getSImm(instr), c); // SLTIU
+        case 0x0C: return emitALU(block, op, OpKind::ANDI , rt, rs, 0, getImm(instr), c);
+        case 0x0D: return emitALU(block, op, OpKind::ORI  , rt, rs, 0, getImm(instr), c);
+        case 0x0E: return emitALU(block, op, OpKind::XORI , rt, rs, 0, getImm(instr), c);
+        case 0x0F: return emitALU(block, op, OpKind::ORI  , rt, 0, 0, getImm(instr) << 16, c); // LUI
+        case 0x20: return emitMemory(block, op, false, 1, true , c); // LB
+        case 0x21: return emitMemory(block, op, false, 2, true , c); // LH
+        case 0x23: return emitMemory(block, op, false, 4, false, c); // LW
+        case 0x24: return emitMemory(block, op, false, 1, false, c); // LBU
+        case 0x25: return emitMemory(block, op, false, 2, false, c); // LHU
+        case 0x28: return emitMemory(block, op, true , 1, false, c); // SB
+        case 0x29: return emitMemory(block, op, true , 2, false, c); // SH
+        case 0x2B: return emitMemory(block, op, true , 4, false, c); // SW
+        default: return emitInterp(block, op, c); // ADDI, COPn, unaligned loads/stores
+    }
+}
+
+/* Removes register writes that are overwritten before they are read (never across barriers) */
+void eliminateDeadWrites(Block &block) {
+    u32 live = ALL_REGS;
+
+    std::vector<Op> ops;
+
+    for (auto op = block.ops.rbegin(); op != block.ops.rend(); op++) {
+        if (isBarrier(op->kind)) {
+            live = ALL_REGS;
+
+            ops.push_back(*op);
+
+            continue;
+        }
+
+        if (isALU(op->kind)) {
+            if (!(live & (1u << op->dst))) continue;
+
+            live &= ~(1u << op->dst);
+        }
+
+        switch (op->kind) {
+            case OpKind::MOVI: case OpKind::LoadRAM: case OpKind::LoadSPRAM: case OpKind::Fetch: case OpKind::Advance: case OpKind::Cancel: break;
+            case OpKind::StoreSPRAM: live |= 1u << op->rt; break;
+            default:
+                live |= 1u << op->rs;
+
+                if (!isRI(op->kind)) live |= 1u << op->rt;
+        }
+
+        ops.push_back(*op);
+    }
+
+    block.ops.assign(ops.rbegin(), ops.rend());
+}
+
+/* Translates the block at a virtual address */
+Block *compile(u32 vaddr) {
+    auto block = new Block{vaddr, 0, false, true, {}};
+
+    Constants c;
+
+    c.forget();
+
+    /* Instruction boundaries that still have to commit a load (the first one is done by execute()),
+     * a load from before the block may be pending at the second instruction
+     */
+    int pendingLoads = 1;
+
+    int fetchIdx = -1; // Fetch operation of the current cache line
+
+    /* Emits a fetch operation at the start of every cache line */
+    auto fetch = [&](u32 addr) {
+        if ((fetchIdx < 0) || !(addr & 0xF)) {
+            Op op{};
+
+            op.kind = OpKind::Fetch;
+            op.addr = addr;
+
+            block->ops.push_back(op);
+
+            fetchIdx = block->ops.size() - 1;
+        }
+
+        block->ops[fetchIdx].imm++;
+    };
+
+    /* Emits a load delay slot commit if one may be pending, returns true if one was emitted */
+    auto advance = [&](int index) {
+        if ((index == 0) || (pendingLoads == 0)) return false;
+
+        Op op{};
+
+        op.kind  = OpKind::Advance;
+        op.index = index;
+
+        block->ops.push_back(op);
+
+        pendingLoads--;
+
+        return true;
+    };
+
+    /* Translates one instruction, keeps the load delay slots in sync with the interpreter */
+    auto translateDelayed = [&](u32 instr, u32 addr, int index, bool isDelaySlot) {
+        fetch(addr);
+
+        const bool isAdvance = advance(index);
+
+        const auto opCount = block->ops.size();
+
+        translate(*block, instr, addr, index, isDelaySlot, c);
+
+        /* Native register writes don't go through set(), a load from the previous block may be pending at the first instruction */
+        if (((index == 0) || isAdvance) && (block->ops.size() > opCount) && isALU(block->ops.back().kind)) {
+            Op op{};
+
+            op.kind  = OpKind::Cancel;
+            op.dst   = block->ops.back().dst;
+            op.index = index;
+
+            block->ops.push_back(op);
+        }
+
+        if (isLoad(instr)) pendingLoads = 2;
+    };
+
+    for (int n = 0; n < MAX_BLOCK_SIZE; n++) {
+        const auto addr = vaddr + 4 * n;
+
+        if ((addr & ~PAGE_MASK) != (vaddr & ~PAGE_MASK)) break;
+
+        /* Breakpoints are reported by the instruction cache, leave them to the interpreter */
+        if (debugger::isBreakpoint(addr & 0x1FFFFFFC)) break;
+
+        const auto instr = bus::readCode32(addr & 0x1FFFFFFC);
+
+        if (isBranch(instr)) {
+            const auto dsAddr = addr + 4;
+
+            if ((dsAddr & ~PAGE_MASK) != (vaddr & ~PAGE_MASK)) break;
+
+            if (debugger::isBreakpoint(dsAddr & 0x1FFFFFFC)) break;
+
+            const auto dsInstr = bus::readCode32(dsAddr & 0x1FFFFFFC);
+
+            if (isBranch(dsInstr)) break; // Let the interpreter handle branches in delay slots
+
+            fetch(addr);
+            advance(n);
+
+            Op op{};
+
+            op.kind  = OpKind::Branch;
+            op.instr = instr;
+            op.addr  = addr;
+            op.index = n;
+
+            block->ops.push_back(op);
+
+            c.forget(); // Link registers
+
+            translateDelayed(dsInstr, dsAddr, n + 1, true);
+
+            block->size      = n + 2;
+            block->hasBranch = true;
+
+            break;
+        }
+
+        translateDelayed(instr, addr, n, false);
+
+        block->size = n + 1;
+
+        if (isBlockEnd(instr)) break;
+    }
+
+    if (!block->size) {
+        delete block;
+
+        block = &noBlock;
+    }
+
+    /* Stores to translated code invalidate the block */
+    const auto phys = vaddr & 0x1FFFFFFF;
+
+    if (phys < RAM_SIZE) {
+        for (u32 i = 0; i < std::max(block->size, 1u); i++) smc::markCode(phys + 4 * i);
+    }
+
+    if (block != &noBlock) eliminateDeadWrites(*block);
+
+    return block;
+}
+
+/* Discards blocks overlapping an overwritten RAM range */
+void invalidate(u32 addr, u32 size) {
+    /* Blocks don't cross pages and are at most MAX_BLOCK_SIZE instructions long */
+    const auto pageStart = addr & ~PAGE_MASK;
+
+    const auto start = ((addr - pageStart) > (4 * MAX_BLOCK_SIZE)) ? (addr - 4 * MAX_BLOCK_SIZE) : pageStart;
+
+    isProbed[addr / CODE_PAGE_SIZE] = false; // Cached blocks may be stale now
+
+    for (u32 a = start; a < (addr + size); a += 4) {
+        auto &block = ramBlocks[a >> 2];
+
+        if (!block) continue;
+
+        if (block == &noBlock) {
+            if (a >= addr) block = NULL;
+
+            continue;
+        }
+
+        if ((a + 4 * block->size) > addr) {
+            block->isValid = false;
+
+            retiredBlocks.push_back(block);
+
+            block = NULL;
+        }
+    }
+}
+
+/* Returns the block table entry of a physical address, NULL if code there is never translated */
+Block **getEntry(u32 addr) {
+    if (addr < 0x100) return NULL; // BIOS call hooks
+
+    if (addr < RAM_SIZE) return &ramBlocks[addr >> 2];
+
+    if ((addr >= BIOS_BASE) && (addr < (BIOS_BASE + BIOS_SIZE))) return &biosBlocks[(addr - BIOS_BASE) >> 2];
+
+    return NULL;
+}
+
+/* --- Translation cache --- */
+
+/* Cached blocks of a page (in that order): vaddr (u32), size (u32), hasBranch (u8), op count (u32), ops */
+constexpr size_t BLOCK_HEADER_SIZE = 13;
+
+/* Returns the code page of a physical address (RAM, then BIOS) */
+u32 getPage(u32 addr) {
+    return (addr < RAM_SIZE) ? (addr / CODE_PAGE_SIZE) : ((RAM_SIZE + addr - BIOS_BASE) / CODE_PAGE_SIZE);
+}
+
+/* Returns the physical base address of a code page */
+u32 getPageAddr(u32 page) {
+    return (page < (RAM_SIZE / CODE_PAGE_SIZE)) ? (page * CODE_PAGE_SIZE) : (BIOS_BASE + (page * CODE_PAGE_SIZE - RAM_SIZE));
+}
+
+/* Returns the block table entries of a code page */
+Block **getPageBlocks(u32 page) {
+    return (page < (RAM_SIZE / CODE_PAGE_SIZE)) ? &ramBlocks[(page * CODE_PAGE_SIZE) >> 2] : &biosBlocks[(page * CODE_PAGE_SIZE - RAM_SIZE) >> 2];
+}
+
+/* Checks an op restored from the translation cache, direct accesses have to stay inside of RAM and the scratchpad */
+bool isValidOp(const Op &op, u32 blockSize) {
+    if ((op.kind > OpKind::Branch) || (op.dst >= 32) || (op.rs >= 32) || (op.rt >= 32) || (op.index >= blockSize)) return false;
+
+    switch (op.kind) {
+        case OpKind::SLL: case OpKind::SRL: case OpKind::SRA:
+            return op.imm < 32;
+        case OpKind::LoadRAM: case OpKind::LoadSPRAM: case OpKind::LoadIO:
+        case OpKind::StoreRAM: case OpKind::StoreSPRAM: case OpKind::StoreIO:
+            if (((op.size != 1) && (op.size != 2) && (op.size != 4)) || (op.imm & (op.size - 1))) return false;
+
+            if ((op.kind == OpKind::LoadRAM) || (op.kind == OpKind::StoreRAM)) return op.imm < RAM_SIZE;
+            if ((op.kind == OpKind::LoadSPRAM) || (op.kind == OpKind::StoreSPRAM)) return op.imm < SPRAM_SIZE;
+
+            return true;
+        case OpKind::Fetch:
+            return op.imm <= blockSize;
+        default:
+            return true;
+    }
+}
+
+/* Restores the cached blocks of a code page, the page is hashed once until code in it is overwritten */
+void probeTranslationCache(u32 addr) {
+    const auto page = getPage(addr);
+
+    /* Pages with self-modifying code would be rehashed all the time */
+    if (isProbed[page] || (probeCount[page] >= MAX_PROBES)) return;
+
+    isProbed[page] = true;
+
+    probeCount[page]++;
+
+    const auto pageAddr = getPageAddr(page);
+
+    const auto data = tcache::find(tcache::hashCode(pageAddr, CODE_PAGE_SIZE, bus::readCode32));
+
+    if (!data) return;
+
+    auto blocks = getPageBlocks(page);
+
+    for (size_t offset = 0; (offset + BLOCK_HEADER_SIZE) <= data->size();) {
+        const auto header = &(*data)[offset];
+
+        u32 vaddr, size, opCount;
+
+        std::memcpy(&vaddr, &header[0], sizeof(u32));
+        std::memcpy(&size, &header[4], sizeof(u32));
+        std::memcpy(&opCount, &header[9], sizeof(u32));
+
+        offset += BLOCK_HEADER_SIZE + (size_t)opCount * sizeof(Op);
+
+        /* Malformed entry */
+        if ((offset > data->size()) || ((vaddr & 0x1FFFF000) != pageAddr) || !size || (size > MAX_BLOCK_SIZE)) return;
+
+        auto &entry = blocks[(vaddr & PAGE_MASK) >> 2];
+
+        if (entry) continue;
+
+        std::vector<Op> ops(opCount);
+
+        std::memcpy(ops.data(), &header[BLOCK_HEADER_SIZE], opCount * sizeof(Op));
+
+        for (const auto &op : ops) {
+            if (!isValidOp(op, size)) return;
+        }
+
+        entry = new Block{vaddr, size, header[8] != 0, true, std::move(ops)};
+
+        /* Stores to translated code invalidate the block */
+        if (pageAddr < RAM_SIZE) {
+            for (u32 i = 0; i < size; i++) smc::markCode((vaddr & 0x1FFFFFFF) + 4 * i);
+        }
+    }
+}
+
+/* Adds the blocks of all translated pages to the translation cache (on exit) */
+void storeTranslations() {
+    std::vector<u8> data;
+
+    for (u32 page = 0; page < CODE_PAGE_COUNT; page++) {
+        const auto blocks = getPageBlocks(page);
+
+        data.clear();
+
+        for (u32 i = 0; i < (CODE_PAGE_SIZE >> 2); i++) {
+            const auto block = blocks[i];
+
+            if (!block || (block == &noBlock)) continue;
+
+            const u32 opCount = block->ops.size();
+
+            const auto offset = data.size();
+
+            data.resize(offset + BLOCK_HEADER_SIZE + opCount * sizeof(Op));
+
+            const auto header = &data[offset];
+
+            std::memcpy(&header[0], &block->vaddr, sizeof(u32));
+            std::memcpy(&header[4], &block->size, sizeof(u32));
+            std::memcpy(&header[9], &opCount, sizeof(u32));
+
+            header[8] = block->hasBranch;
+
+            std::memcpy(&header[BLOCK_HEADER_SIZE], block->ops.data(), opCount * sizeof(Op));
+        }
+
+        if (!data.empty()) tcache::store(tcache::hashCode(getPageAddr(page), CODE_PAGE_SIZE, bus::readCode32), data.data(), data.size());
+    }
+}
+
+void init() {
+    ram   = bus::getRAM();
+    spram = bus::getSPRAM();
+
+    smc::addInvalidateFunc(invalidate);
+
+    useCache = tcache::enabled && !debugger::isActive();
+
+    if (tcache::enabled && !useCache) std::printf("[IR        ] Translation cache disabled while debugging\n");
+
+    /* Runs before the translation cache is written */
+    if (useCache) std::atexit(storeTranslations);
+}
+
+/* --- Execution --- */
+
+/* Charges all instructions up to and including op, sets PC state of an instruction that may leave the block */
+void sync(const Op &op, i64 &charged) {
+    cycles -= op.index + 1 - charged;
+
+    charged = op.index + 1;
+
+    if (op.isDelaySlot) return; // Already set up by the branch
+
+    cpc = op.addr;
+    pc  = op.addr + 4;
+    npc = op.addr + 8;
+}
+
+u32 loadDirect(const u8 *mem, u32 size, bool isSigned) {
+    switch (size) {
+        case 1: return (isSigned) ? (u32)(i8)mem[0] : mem[0];
+        case 2:
+            {
+                u16 data;
+
+                std::memcpy(&data, mem, sizeof(u16));
+
+                return (isSigned) ? (u32)(i16)data : data;
+            }
+        default:
+            {
+                u32 data;
+
+                std::memcpy(&data, mem, sizeof(u32));
+
+                return data;
+            }
+    }
+}
+
+u32 loadIO(u32 addr, u32 size, bool isSigned) {
+    switch (size) {
+        case 1: return (isSigned) ? (u32)(i8)bus::readCPU8(addr) : bus::readCPU8(addr);
+        case 2: return (isSigned) ? (u32)(i16)bus::readCPU16(addr) : bus::readCPU16(addr);
+        default: return bus::readCPU32(addr);
+    }
+}
+
+void storeIO(u32 addr, u32 size, u32 data) {
+    switch (size) {
+        case 1: return bus::write8(addr, data);
+        case 2: return bus::write16(addr, data);
+        default: return bus::write32(addr, data);
+    }
+}
+
+/* Executes a block, returns the number of executed guest instructions */
+i64 execute(Block &block) {
+    inDelaySlot[0] = false; // Blocks never start in a delay slot
+
+    advanceLoadDelay();
+
+    i64 charged = 0; // Instructions charged to the cycle budget, time is kept exact for everything that can observe it
+
+    for (const auto &op : block.ops) {
+        switch (op.kind) {
+            case OpKind::MOVI : regs[op.dst] = op.imm; break;
+            case OpKind::ADDU : regs[op.dst] = regs[op.rs] + regs[op.rt]; break;
+            case OpKind::ADDUI: regs[op.dst] = regs[op.rs] + op.imm; break;
+            case OpKind::SUBU : regs[op.dst] = regs[op.rs] - regs[op.rt]; break;
+            case OpKind::AND  : regs[op.dst] = regs[op.rs] & regs[op.rt]; break;
+            case OpKind::ANDI : regs[op.dst] = regs[op.rs] & op.imm; break;
+            case OpKind::OR   : regs[op.dst] = regs[op.rs] | regs[op.rt]; break;
+            case OpKind::ORI  : regs[op.dst] = regs[op.rs] | op.imm; break;
+            case OpKind::XOR  : regs[op.dst] = regs[op.rs] ^ regs[op.rt]; break;
+            case OpKind::XORI : regs[op.dst] = regs[op.rs] ^ op.imm; break;
+            case OpKind::NOR  : regs[op.dst] = ~(regs[op.rs] | regs[op.rt]); break;
+            case OpKind::SLT  : regs[op.dst] = (i32)regs[op.rs] < (i32)regs[op.rt]; break;
+            case OpKind::SLTI : regs[op.dst] = (i32)regs[op.rs] < (i32)op.imm; break;
+            case OpKind::SLTU : regs[op.dst] = regs[op.rs] < regs[op.rt]; break;
+            case OpKind::SLTUI: regs[op.dst] = regs[op.rs] < op.imm; break;
+            case OpKind::SLL  : regs[op.dst] = regs[op.rs] << op.imm; break;
+            case OpKind::SRL  : regs[op.dst] = regs[op.rs] >> op.imm; break;
+            case OpKind::SRA  : regs[op.dst] = (i32)regs[op.rs] >> op.imm; break;
+            case OpKind::SLLV : regs[op.dst] = regs[op.rs] << (regs[op.rt] & 0x1F); break;
+            case OpKind::SRLV : regs[op.dst] = regs[op.rs] >> (regs[op.rt] & 0x1F); break;
+            case OpKind::SRAV : regs[op.dst] = (i32)regs[op.rs] >> (regs[op.rt] & 0x1F); break;
+            case OpKind::LoadRAM  : setLoad(op.rt, loadDirect(&ram[op.imm], op.size, op.isSigned)); break;
+            case OpKind::LoadSPRAM: setLoad(op.rt, loadDirect(&spram[op.imm], op.size, op.isSigned)); break;
+            case OpKind::LoadIO:
+                {
+                    sync(op, charged);
+
+                    const auto expectedPC = pc;
+
+                    setLoad(op.rt, loadIO(op.imm, op.size, op.isSigned));
+
+                    if ((pc != expectedPC) || isInterruptRequested) return op.index + 1;
+                }
+                break;
+            case OpKind::StoreRAM:
+                std::memcpy(&ram[op.imm], &regs[op.rt], op.size); // Little endian host
+
+                bus::attr::checkWrite(bus::attr::Region::RAM, op.imm, op.size);
+
+                if (!block.isValid) {
+                    sync(op, charged);
+
+                    return op.index + 1;
+                }
+                break;
+            case OpKind::StoreSPRAM:
+                std::memcpy(&spram[op.imm], &regs[op.rt], op.size);
+
+                bus::attr::checkWrite(bus::attr::Region::SPRAM, op.imm, op.size);
+                break;
+            case OpKind::Fetch  : icache::fetchBlock(op.addr, op.imm); break;
+            case OpKind::Advance: advanceLoadDelay(); break;
+            case OpKind::Cancel:
+                if (loadDelay[0].idx == op.dst) loadDelay[0].idx = LOAD_DUMMY;
+                break;
+            case OpKind::StoreIO:
+            case OpKind::Interp:
+                {
+                    sync(op, charged);
+
+                    const auto expectedPC = pc;
+
+                    if (op.kind == OpKind::StoreIO) {
+                        storeIO(op.imm, op.size, regs[op.rt]);
+                    } else {
+                        decodeInstr(op.instr);
+                    }
+
+                    /* Exception, self-modifying code or interrupt request (ends the time slice) */
+                    if ((pc != expectedPC) || !block.isValid || isInterruptRequested) return op.index + 1;
+                }
+                break;
+            case OpKind::Branch:
+                {
+                    sync(op, charged);
+
+                    const auto expectedPC = pc;
+
+                    decodeInstr(op.instr);
+
+                    if ((pc != expectedPC) || !block.isValid || isInterruptRequested) return op.index + 1;
+
+                    /* Enter the delay slot */
+                    cpc = op.addr + 4;
+
+                    inDelaySlot[0] = inDelaySlot[1];
+                    inDelaySlot[1] = false;
+
+                    pc   = npc;
+                    npc += 4;
+                }
+                break;
+        }
+    }
+
+    if (!block.hasBranch) {
+        cpc = block.vaddr + 4 * (block.size - 1);
+        pc  = block.vaddr + 4 * block.size;
+        npc = pc + 4;
+    }
+
+    cycles -= block.size - charged;
+
+    return block.size;
+}
+
+i64 run(i64 maxCycles) {
+    if (!retiredBlocks.empty()) {
+        for (auto block : retiredBlocks) delete block;
+
+        retiredBlocks.clear();
+    }
+
+    /* Stores are dropped while the cache is isolated, leave this to the interpreter */
+    if (cop0::isCacheIsolated()) return 0;
+
+    auto entry = getEntry(pc & 0x1FFFFFFF);
+
+    if (!entry) return 0;
+
+    auto block = *entry;
+
+    if (!block && useCache) {
+        probeTranslationCache(pc & 0x1FFFFFFF);
+
+        block = *entry;
+    }
+
+    if (!block || ((block != &noBlock) && (block->vaddr != pc))) {
+        if (block) {
+            block->isValid = false;
+
+            retiredBlocks.push_back(block);
+        }
+
+        block = *entry = compile(pc);
+    }
+
+    if ((block == &noBlock) || (block->size > maxCycles)) return 0;
+
+    return execute(*block);
+}
+
+}
@@ -0,0 +1,17 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include "../../common/types.hpp"
+
+namespace ps::cpu::ir {
+
+void init();
+
+/* Runs the block at PC if it fits into the time slice and charges its cycles, returns the number of executed instructions (0 if no block was run) */
+i64 run(i64 maxCycles);
+
+}
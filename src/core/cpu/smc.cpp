@@ -0,0 +1,60 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "smc.hpp"
+
+#include <vector>
+
+namespace ps::cpu::smc {
+
+using bus::attr::Region;
+
+u64 codeLines[PAGE_COUNT]; // One bit per line that contains decoded code
+
+std::vector<InvalidateFunc> invalidateFuncs;
+
+/* Invalidates the lines of a store to a page with code (CODE is only set on RAM pages) */
+void onWrite(Region, u32 addr, u32 size) {
+    for (u32 line = addr >> LINE_SHIFT; line <= ((addr + size - 1) >> LINE_SHIFT); line++) invalidate(line << LINE_SHIFT);
+}
+
+void init() {
+    bus::attr::setWriteFunc(bus::attr::CODE, onWrite);
+}
+
+void addInvalidateFunc(InvalidateFunc func) {
+    invalidateFuncs.push_back(func);
+}
+
+/* Marks a RAM word as decoded code */
+void markCode(u32 addr) {
+    addr &= RAM_SIZE - 1;
+
+    const auto page = addr >> PAGE_SHIFT;
+
+    bus::attr::set(Region::RAM, addr, bus::attr::CODE);
+
+    codeLines[page] |= 1ull << ((addr >> LINE_SHIFT) & 63);
+}
+
+/* Invalidates the line containing addr if it contains decoded code */
+void invalidate(u32 addr) {
+    addr &= RAM_SIZE - 1;
+
+    const auto page = addr >> PAGE_SHIFT;
+    const auto mask = 1ull << ((addr >> LINE_SHIFT) & 63);
+
+    if (!(codeLines[page] & mask)) return;
+
+    codeLines[page] &= ~mask;
+
+    if (!codeLines[page]) bus::attr::clear(Region::RAM, addr, bus::attr::CODE);
+
+    const auto lineAddr = addr & ~((1u << LINE_SHIFT) - 1);
+
+    for (auto func : invalidateFuncs) func(lineAddr, 1 << LINE_SHIFT);
+}
+
+}
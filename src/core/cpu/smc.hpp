@@ -0,0 +1,31 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include "cpu.hpp"
+#include "../bus/attr.hpp"
+
+namespace ps::cpu::smc {
+
+/* --- Self-modifying code detection constants --- */
+
+constexpr u32 PAGE_SHIFT = bus::attr::PAGE_SHIFT; // Pages with code have the CODE attribute
+constexpr u32 LINE_SHIFT = 6;  // 64-byte lines, 64 lines per page
+
+constexpr u32 PAGE_COUNT = RAM_SIZE >> PAGE_SHIFT;
+
+/* Called with the physical RAM range of an invalidated line */
+using InvalidateFunc = void (*)(u32 addr, u32 size);
+
+void init();
+
+void addInvalidateFunc(InvalidateFunc func);
+
+void markCode(u32 addr);
+
+void invalidate(u32 addr);
+
+}
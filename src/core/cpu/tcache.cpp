@@ -0,0 +1,142 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "tcache.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+namespace ps::cpu::tcache {
+
+/* Translation cache file layout (little endian):
+ *
+ * "MTC0", version (u32), entry count (u32)
+ * Entries: content hash (u64), size (u32), translation data
+ */
+
+/* --- Translation cache constants --- */
+
+constexpr u32 CACHE_VERSION = 1;
+
+constexpr size_t MAX_ENTRIES = 16384;
+
+bool enabled = false;
+
+const char *cachePath = NULL;
+
+std::unordered_map<u64, std::vector<u8>> entries;
+
+bool isDirty = false;
+
+/* Loads the cache file, a missing or invalid file results in an empty cache */
+void load() {
+    auto file = std::fopen(cachePath, "rb");
+
+    if (!file) return;
+
+    char magic[4];
+    u32  version, entryCount;
+
+    bool isOK = (std::fread(magic, 1, 4, file) == 4) && !std::memcmp(magic, "MTC0", 4);
+
+    isOK = isOK && (std::fread(&version, sizeof(version), 1, file) == 1) && (version == CACHE_VERSION);
+    isOK = isOK && (std::fread(&entryCount, sizeof(entryCount), 1, file) == 1);
+
+    for (u32 i = 0; isOK && (i < entryCount); i++) {
+        u64 hash;
+        u32 size;
+
+        isOK = (std::fread(&hash, sizeof(hash), 1, file) == 1) && (std::fread(&size, sizeof(size), 1, file) == 1);
+
+        if (!isOK) break;
+
+        std::vector<u8> data(size);
+
+        isOK = std::fread(data.data(), 1, size, file) == size;
+
+        if (isOK) entries[hash] = std::move(data);
+    }
+
+    std::fclose(file);
+
+    if (!isOK) {
+        std::printf("[TCache    ] \"%s\" is not a valid translation cache, ignoring it\n", cachePath);
+
+        entries.clear();
+
+        return;
+    }
+
+    std::printf("[TCache    ] Loaded %zu cached regions from \"%s\"\n", entries.size(), cachePath);
+}
+
+/* Writes the cache file if new regions were translated */
+void save() {
+    if (!isDirty) return;
+
+    auto file = std::fopen(cachePath, "wb");
+
+    if (!file) {
+        std::printf("[TCache    ] Unable to open file \"%s\"\n", cachePath);
+
+        return;
+    }
+
+    const u32 entryCount = entries.size();
+
+    std::fwrite("MTC0", 1, 4, file);
+    std::fwrite(&CACHE_VERSION, sizeof(CACHE_VERSION), 1, file);
+    std::fwrite(&entryCount, sizeof(entryCount), 1, file);
+
+    for (auto &[hash, data] : entries) {
+        const u32 size = data.size();
+
+        std::fwrite(&hash, sizeof(hash), 1, file);
+        std::fwrite(&size, sizeof(size), 1, file);
+        std::fwrite(data.data(), 1, size, file);
+    }
+
+    std::fclose(file);
+
+    std::printf("[TCache    ] Saved %u cached regions to \"%s\"\n", entryCount, cachePath);
+}
+
+void init(const char *path) {
+    if (!path) return;
+
+    cachePath = path;
+
+    load();
+
+    std::atexit(save);
+
+    enabled = true;
+}
+
+const std::vector<u8> *find(u64 hash) {
+    const auto entry = entries.find(hash);
+
+    return (entry != entries.end()) ? &entry->second : NULL;
+}
+
+void store(u64 hash, const u8 *data, size_t size) {
+    auto entry = entries.find(hash);
+
+    if (entry == entries.end()) {
+        if (entries.size() >= MAX_ENTRIES) return;
+
+        entries[hash] = std::vector<u8>(data, data + size);
+    } else {
+        if ((entry->second.size() == size) && !std::memcmp(entry->second.data(), data, size)) return;
+
+        entry->second.assign(data, data + size);
+    }
+
+    isDirty = true;
+}
+
+}
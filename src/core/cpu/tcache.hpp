@@ -0,0 +1,37 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "../../common/types.hpp"
+
+namespace ps::cpu::tcache {
+
+extern bool enabled;
+
+void init(const char *path);
+
+/* Returns cached translation data of a code region, NULL if there is none */
+const std::vector<u8> *find(u64 hash);
+
+void store(u64 hash, const u8 *data, size_t size);
+
+/* Hashes a code region (64-bit FNV-1a over the instruction words, seeded with address and size) */
+template<typename ReadFunc>
+u64 hashCode(u32 addr, u32 size, ReadFunc read) {
+    u64 hash = 0xCBF29CE484222325 ^ ((u64)addr << 32) ^ size;
+
+    for (u32 i = 0; i < size; i += 4) {
+        hash ^= read(addr + i);
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
+}
@@ -0,0 +1,132 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "debugger.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "bus/attr.hpp"
+#include "bus/bus.hpp"
+#include "cpu/cpu.hpp"
+
+namespace ps::debugger {
+
+/* Pages with read watchpoints are left unmapped in the bus page table, pages with write watchpoints have the WATCH attribute.
+ * Breakpoints are tagged in the instruction cache, only fetches of these words miss the fast path.
+ */
+
+constexpr u32 PHYS_MASK = 0x1FFFFFFF;
+
+constexpr u32 RAM_SIZE   = 0x200000;
+constexpr u32 SPRAM_BASE = 0x1F800000;
+constexpr u32 SPRAM_SIZE = 0x400;
+
+std::vector<u32> breakpoints, readWatchpoints, writeWatchpoints;
+
+u64 hitCount = 0;
+
+bool contains(const std::vector<u32> &addrs, u32 addr) {
+    for (const auto a : addrs) {
+        if (a == addr) return true;
+    }
+
+    return false;
+}
+
+/* Returns true if a watchpoint lies within [addr;addr+size) */
+bool overlaps(const std::vector<u32> &addrs, u32 addr, u32 size) {
+    for (const auto a : addrs) {
+        if ((a >= addr) && (a < (addr + size))) return true;
+    }
+
+    return false;
+}
+
+void printRegs() {
+    for (int i = 0; i < 32; i += 4) {
+        std::printf("[Debugger  ] r%-2d = 0x%08X r%-2d = 0x%08X r%-2d = 0x%08X r%-2d = 0x%08X\n",
+            i, cpu::regs[i], i + 1, cpu::regs[i + 1], i + 2, cpu::regs[i + 2], i + 3, cpu::regs[i + 3]
+        );
+    }
+
+    std::printf("[Debugger  ] LO  = 0x%08X HI  = 0x%08X\n", cpu::regs[32], cpu::regs[33]);
+}
+
+/* Reports stores to pages with write watchpoints */
+void onWrite(bus::attr::Region region, u32 addr, u32 size) {
+    const u8 *mem;
+
+    u32 base;
+
+    switch (region) {
+        case bus::attr::Region::RAM  : mem = bus::getRAM(); base = 0; addr &= RAM_SIZE - 1; break;
+        case bus::attr::Region::SPRAM: mem = bus::getSPRAM(); base = SPRAM_BASE; addr &= SPRAM_SIZE - 1; break;
+        default: return;
+    }
+
+    if (!overlaps(writeWatchpoints, base + addr, size)) return;
+
+    if (size > sizeof(u32)) {
+        std::printf("[Debugger  ] %u-byte block write @ 0x%08X (PC = 0x%08X, hit %llu)\n", size, base + addr, cpu::cpc, (unsigned long long)++hitCount);
+
+        return;
+    }
+
+    u32 data = 0;
+
+    std::memcpy(&data, &mem[addr], size);
+
+    std::printf("[Debugger  ] %u-bit write @ 0x%08X = 0x%0*X (PC = 0x%08X, hit %llu)\n", 8 * size, base + addr, 2 * size, data, cpu::cpc, (unsigned long long)++hitCount);
+}
+
+void init(const Config &config) {
+    for (const auto addr : config.breakpoints) breakpoints.push_back(addr & ~3 & PHYS_MASK);
+    for (const auto addr : config.readWatchpoints) readWatchpoints.push_back(addr & PHYS_MASK);
+    for (const auto addr : config.writeWatchpoints) writeWatchpoints.push_back(addr & PHYS_MASK);
+
+    if (breakpoints.empty() && readWatchpoints.empty() && writeWatchpoints.empty()) return;
+
+    bus::attr::setWriteFunc(bus::attr::WATCH, onWrite);
+
+    for (const auto addr : writeWatchpoints) {
+        if (addr < RAM_SIZE) {
+            bus::attr::set(bus::attr::Region::RAM, addr, bus::attr::WATCH);
+        } else if ((addr >= SPRAM_BASE) && (addr < (SPRAM_BASE + SPRAM_SIZE))) {
+            bus::attr::set(bus::attr::Region::SPRAM, addr, bus::attr::WATCH);
+        }
+    }
+
+    std::printf("[Debugger  ] %zu breakpoint(s), %zu read watchpoint(s), %zu write watchpoint(s)\n", breakpoints.size(), readWatchpoints.size(), writeWatchpoints.size());
+}
+
+bool isBreakpoint(u32 addr) {
+    return !breakpoints.empty() && contains(breakpoints, addr & ~3);
+}
+
+/* Returns true if accesses to [addr;addr+size) have to be checked */
+bool isWatched(u32 addr, u32 size, bool isWrite) {
+    return overlaps((isWrite) ? writeWatchpoints : readWatchpoints, addr, size);
+}
+
+/* Returns true if any breakpoints or watchpoints are set */
+bool isActive() {
+    return !breakpoints.empty() || !readWatchpoints.empty() || !writeWatchpoints.empty();
+}
+
+void reportBreakpoint(u32 vaddr) {
+    std::printf("[Debugger  ] Breakpoint @ 0x%08X (hit %llu)\n", vaddr, (unsigned long long)++hitCount);
+
+    printRegs();
+}
+
+void checkRead(u32 addr, u32 size, u32 data) {
+    if (!overlaps(readWatchpoints, addr, size)) return;
+
+    std::printf("[Debugger  ] %u-bit read @ 0x%08X = 0x%0*X (PC = 0x%08X, hit %llu)\n", 8 * size, addr, 2 * size, data, cpu::cpc, (unsigned long long)++hitCount);
+}
+
+}
@@ -0,0 +1,24 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include "Mari.hpp"
+
+namespace ps::debugger {
+
+void init(const Config &config);
+
+/* Addresses are physical */
+bool isBreakpoint(u32 addr);
+bool isWatched(u32 addr, u32 size, bool isWrite);
+
+bool isActive();
+
+void reportBreakpoint(u32 vaddr);
+
+void checkRead(u32 addr, u32 size, u32 data);
+
+}
@@ -8,9 +8,12 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 
 #include "../intc.hpp"
+#include "../profiler.hpp"
 #include "../scheduler.hpp"
+#include "../tracer.hpp"
 #include "../bus/bus.hpp"
 #include "../cdrom/cdrom.hpp"
 #include "../gpu/gpu.hpp"
@@ -95,6 +98,8 @@ void transferEndEvent(int chnID) {
 
     //std::printf("[DMAC      ] Channel %d (%s) transfer end\n", chnID, chnNames[chnID]);
 
+    tracer::asyncEnd("dma", chnNames[chnID], chnID);
+
     chcr.str = false;
 
     /* Set interrupt pending flag, check for interrupts */
@@ -105,6 +110,18 @@ void transferEndEvent(int chnID) {
     }
 }
 
+/* Returns profiler zone of a DMA channel */
+profiler::Zone getZone(Channel chn) {
+    return static_cast<profiler::Zone>(static_cast<int>(profiler::Zone::DMA0) + static_cast<int>(chn));
+}
+
+/* Schedules transfer end event */
+void scheduleTransferEnd(Channel chn, i64 cycles) {
+    PROFILE_CYCLES(getZone(chn), cycles);
+
+    scheduler::addEvent(idTransferEnd, static_cast<int>(chn), cycles);
+}
+
 /* Returns DMA channel from address */
 Channel getChannel(u32 addr) {
     switch ((addr >> 4) & 0xFF) {
@@ -127,7 +144,7 @@ void doCDROM() {
     const auto chnID = Channel::CDROM;
 
     auto &chn  = channels[static_cast<int>(chnID)];
-    auto &chcr = chn.chcr;
+    [[maybe_unused]] auto &chcr = chn.chcr; // Only used by asserts
 
     //std::printf("[DMAC      ] CDROM transfer\n");
 
@@ -142,7 +159,7 @@ void doCDROM() {
         chn.madr += 4;
     }
 
-    scheduler::addEvent(idTransferEnd, static_cast<int>(chnID), 24 * chn.size);
+    scheduleTransferEnd(chnID, 24 * chn.size);
 
     /* Clear BCR */
     chn.count = 0;
@@ -208,7 +225,7 @@ void doGPU() {
         }
     }
 
-    scheduler::addEvent(idTransferEnd, static_cast<int>(chnID), len);
+    scheduleTransferEnd(chnID, len);
 
     /* Clear DMA request */
     //chn.drq = false;
@@ -223,7 +240,7 @@ void doMDECIN() {
     const auto chnID = Channel::MDECIN;
 
     auto &chn  = channels[static_cast<int>(chnID)];
-    auto &chcr = chn.chcr;
+    [[maybe_unused]] auto &chcr = chn.chcr; // Only used by asserts
 
     //std::printf("[DMAC      ] MDEC_IN transfer\n");
 
@@ -238,7 +255,7 @@ void doMDECIN() {
         chn.madr += 4;
     }
 
-    scheduler::addEvent(idTransferEnd, static_cast<int>(chnID), chn.len);
+    scheduleTransferEnd(chnID, chn.len);
 
     /* Clear DRQ */
     chn.drq = false;
@@ -254,7 +271,7 @@ void doMDECOUT() {
     const auto chnID = Channel::MDECOUT;
 
     auto &chn  = channels[static_cast<int>(chnID)];
-    auto &chcr = chn.chcr;
+    [[maybe_unused]] auto &chcr = chn.chcr; // Only used by asserts
 
     //std::printf("[DMAC      ] MDEC_OUT transfer\n");
 
@@ -269,7 +286,7 @@ void doMDECOUT() {
         chn.madr += 4;
     }
 
-    scheduler::addEvent(idTransferEnd, static_cast<int>(chnID), chn.len);
+    scheduleTransferEnd(chnID, chn.len);
 
     /* Clear DRQ */
     chn.drq = false;
@@ -285,7 +302,7 @@ void doOTC() {
     const auto chnID = Channel::OTC;
 
     auto &chn  = channels[static_cast<int>(chnID)];
-    auto &chcr = chn.chcr;
+    [[maybe_unused]] auto &chcr = chn.chcr; // Only used by asserts
 
     //std::printf("[DMAC      ] OTC transfer\n");
 
@@ -303,7 +320,7 @@ void doOTC() {
         chn.madr -= 4;
     }
 
-    scheduler::addEvent(idTransferEnd, static_cast<int>(chnID), chn.size);
+    scheduleTransferEnd(chnID, chn.size);
 
     /* Clear BCR */
     chn.count = 0;
@@ -336,7 +353,7 @@ void doSPU() {
         chn.madr += 4 * chn.len;
     }
 
-    scheduler::addEvent(idTransferEnd, static_cast<int>(chnID), 4 * chn.len);
+    scheduleTransferEnd(chnID, 4 * chn.len);
 
     /* Clear BCR */
     chn.count = 0;
@@ -345,6 +362,10 @@ void doSPU() {
 }
 
 void startDMA(Channel chn) {
+    PROFILE_SCOPE(getZone(chn));
+
+    tracer::asyncBegin("dma", chnNames[static_cast<int>(chn)], static_cast<int>(chn));
+
     switch (chn) {
         case Channel::MDECIN : doMDECIN(); break;
         case Channel::MDECOUT: doMDECOUT(); break;
@@ -13,7 +13,11 @@
 
 #include "../intc.hpp"
 #include "../Mari.hpp"
+#include "../profiler.hpp"
 #include "../scheduler.hpp"
+#include "../simd/simd.hpp"
+#include "../tracer.hpp"
+#include "../bus/attr.hpp"
 #include "../timer/timer.hpp"
 #include "../spu/spu.hpp"
 
@@ -89,37 +93,40 @@ TexWindow texWindow;
 
 CopyInfo dstCopyInfo, srcCopyInfo;
 
-i64 lineCounter = 0;
+i64 frameStart = 0; // Time stamp of line 0 of the current frame
 
 u32 drawMode;
 
 u32 gpuread = 0;
 u32 gpustat = 7 << 26;
 
-u64 idHBLANK, idScanline; // Scheduler
+u64 idVBLANK; // Scheduler
 
-/* Handles HBLANK events */
-void hblankEvent(i64 c) {
-    timer::stepHBLANK();
+enum VBLANKEvent {
+    Start,
+    End,
+};
 
-    scheduler::addEvent(idHBLANK, 0, CYCLES_PER_SCANLINE);
+/* Returns the current scanline, the line counter is derived from the time stamp instead of being stepped */
+i64 getLine() {
+    return (scheduler::now() - frameStart) / CYCLES_PER_SCANLINE;
 }
 
-/* Handles scanline events */
-void scanlineEvent(i64 c) {
-    ++lineCounter;
+/* Returns the number of HBLANKs up to time stamp t (timer 1 catch-up) */
+i64 getHBLANKCount(i64 t) {
+    return (t + CYCLES_PER_SCANLINE - CYCLES_PER_HDRAW) / CYCLES_PER_SCANLINE;
+}
 
-    if (lineCounter < SCANLINES_PER_VDRAW) {
-        if (lineCounter & 1) {
-            gpustat |= 1 << 31;
-        } else {
-            gpustat &= ~(1 << 31);
-        }
-    } else {
-        gpustat &= ~(1 << 31);
-    }
+/* Returns the time stamp of the nth HBLANK */
+i64 getHBLANKTime(i64 n) {
+    return (n - 1) * CYCLES_PER_SCANLINE + CYCLES_PER_HDRAW;
+}
+
+/* Handles VBLANK start/end events */
+void vblankEvent(int param) {
+    if (param == VBLANKEvent::Start) {
+        tracer::asyncBegin("gpu", "vblank", 0);
 
-    if (lineCounter == SCANLINES_PER_VDRAW) {
         intc::sendInterrupt(Interrupt::VBLANK);
 
         timer::gateVBLANKStart();
@@ -127,13 +134,17 @@ void scanlineEvent(i64 c) {
         spu::save();
 
         update((u8 *)vram.data());
-    } else if (lineCounter == SCANLINES_PER_FRAME) {
+
+        scheduler::addEvent(idVBLANK, VBLANKEvent::End, (SCANLINES_PER_FRAME - SCANLINES_PER_VDRAW) * CYCLES_PER_SCANLINE);
+    } else {
+        tracer::asyncEnd("gpu", "vblank", 0);
+
+        frameStart += SCANLINES_PER_FRAME * CYCLES_PER_SCANLINE;
+
         timer::gateVBLANKEnd();
 
-        lineCounter = 0;
+        scheduler::addEvent(idVBLANK, VBLANKEvent::Start, SCANLINES_PER_VDRAW * CYCLES_PER_SCANLINE);
     }
-    
-    scheduler::addEvent(idScanline, 0, CYCLES_PER_SCANLINE);
 }
 
 void setArgCount(int c) {
@@ -151,6 +162,59 @@ inline u16 toBGR555(u32 c) {
     return (b << 10) | (g << 5) | r;
 }
 
+/* --- Span fill kernels --- */
+
+void fillSpanScalar(u16 *dst, u16 c, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = c;
+}
+
+#ifdef MARI_X86
+MARI_TARGET("sse4.1") void fillSpanSSE41(u16 *dst, u16 c, size_t n) {
+    const auto v = _mm_set1_epi16(c);
+
+    size_t i = 0;
+
+    for (; (i + 8) <= n; i += 8) _mm_storeu_si128((__m128i *)&dst[i], v);
+
+    for (; i < n; i++) dst[i] = c;
+}
+
+MARI_TARGET("avx2") void fillSpanAVX2(u16 *dst, u16 c, size_t n) {
+    const auto v = _mm256_set1_epi16(c);
+
+    size_t i = 0;
+
+    for (; (i + 16) <= n; i += 16) _mm256_storeu_si256((__m256i *)&dst[i], v);
+
+    for (; i < n; i++) dst[i] = c;
+}
+
+MARI_TARGET("avx512f,avx512bw") void fillSpanAVX512(u16 *dst, u16 c, size_t n) {
+    const auto v = _mm512_set1_epi16(c);
+
+    size_t i = 0;
+
+    for (; (i + 32) <= n; i += 32) _mm512_storeu_si512((void *)&dst[i], v);
+
+    if (i < n) _mm512_mask_storeu_epi16(&dst[i], (__mmask32)((1ull << (n - i)) - 1), v);
+}
+#endif
+
+/* Fills n pixels of a VRAM row, bound to the best kernel in init() */
+void (*fillSpan)(u16 *dst, u16 c, size_t n) = fillSpanScalar;
+
+/* Notifies page attribute observers of a write to n pixels starting at (x, y), called once per span */
+void checkVRAMWrite(i32 x, i32 y, u32 n) {
+    bus::attr::checkWriteRange(bus::attr::Region::VRAM, 2 * (x + 1024 * y), 2 * n);
+}
+
+/* Notifies page attribute observers of a write to the bounding box of a primitive */
+void checkVRAMRect(i32 xMin, i32 yMin, i32 xMax, i32 yMax) {
+    if (xMin >= xMax) return;
+
+    for (auto y = yMin; y < yMax; y++) checkVRAMWrite(xMin, y, xMax - xMin);
+}
+
 template<bool conv>
 void drawPixel(i32 x, i32 y, u32 c) {
     if constexpr (conv) {
@@ -254,6 +318,8 @@ void drawFlatTri(const Vertex &v0, const Vertex &v1, const Vertex &v2, u32 color
             if ((w0 >= 0) && (w1 >= 0) && (w2 >= 0)) drawPixel<false>(p.x, p.y, color);
         }
     }
+
+    checkVRAMRect(xMin, yMin, xMax, yMax);
 }
 
 /* Draws a flat rectangle */
@@ -270,10 +336,12 @@ void drawFlatRect(const Vertex &v, i32 w, i32 h, u32 color) {
     auto xMax = std::min(xMin + w, xyarea.x1);
     auto yMax = std::min(yMin + h, xyarea.y1);
 
+    if (xMin >= xMax) return;
+
     for (auto y = yMin; y < yMax; y++) {
-        for (auto x = xMin; x < xMax; x++) {
-            drawPixel<false>(x, y, color);
-        }
+        fillSpan(&vram[xMin + 1024 * y], color, xMax - xMin);
+
+        checkVRAMWrite(xMin, y, xMax - xMin);
     }
 }
 
@@ -333,6 +401,8 @@ void drawShadedTri(const Vertex &v0, const Vertex &v1, const Vertex &v2) {
             }
         }
     }
+
+    checkVRAMRect(xMin, yMin, xMax, yMax);
 }
 
 /* Draws a textured rectangle */
@@ -370,6 +440,8 @@ void drawTexturedRect(const Vertex &v, i32 w, i32 h, u32 clut) {
 
         ++yc;
     }
+
+    checkVRAMRect(xMin, yMin, xMax, yMax);
 }
 
 /* Draws a textured triangle */
@@ -430,10 +502,14 @@ void drawTexturedTri(const Vertex &v0, const Vertex &v1, const Vertex &v2, u32 c
             }
         }
     }
+
+    checkVRAMRect(xMin, yMin, xMax, yMax);
 }
 
 /* GP0(0x02) Fill Rectangle */
 void fillRect() {
+    PROFILE_SCOPE(profiler::Zone::GPUFill);
+
     /* Convert 24-bit to 15-bit here to speed up things */
     const auto c = toBGR555(cmdParam.front() & 0xFFFFFF); cmdParam.pop();
 
@@ -452,19 +528,21 @@ void fillRect() {
     const auto xMax = std::min((i32)(width  + x0), xyarea.x1);
     const auto yMax = std::min((i32)(height + y0), xyarea.y1);
 
-    for (auto y = yMin; y < yMax; y++)
-	{
-		for (auto x = xMin; x < xMax; x++)
-		{
-			drawPixel<false>(x, y, c);
-		}
-	}
+    if (xMin < xMax) {
+        for (auto y = yMin; y < yMax; y++) {
+            fillSpan(&vram[xMin + 1024 * y], c, xMax - xMin);
+
+            checkVRAMWrite(xMin, y, xMax - xMin);
+        }
+    }
 
 	state = GPUState::ReceiveCommand;
 }
 
 /* GP0(0x20) Draw Flat Tri (opaque) */
 void drawTri20() {
+    PROFILE_SCOPE(profiler::Zone::GPUFlatTri);
+
     const auto color = cmdParam.front(); cmdParam.pop();
 
     const auto v0 = cmdParam.front(); cmdParam.pop();
@@ -478,6 +556,8 @@ void drawTri20() {
 
 /* GP0(0x24) Draw Textured Tri */
 void drawTri24() {
+    PROFILE_SCOPE(profiler::Zone::GPUTexturedTri);
+
     const auto c = cmdParam.front(); cmdParam.pop();
 
     Vertex v[3];
@@ -505,6 +585,8 @@ void drawTri24() {
 
 /* GP0(0x30) Draw Shaded Triangle (opaque) */
 void drawTri30() {
+    PROFILE_SCOPE(profiler::Zone::GPUShadedTri);
+
     const auto c0 = cmdParam.front(); cmdParam.pop();
     const auto v0 = cmdParam.front(); cmdParam.pop();
     const auto c1 = cmdParam.front(); cmdParam.pop();
@@ -519,6 +601,8 @@ void drawTri30() {
 
 /* GP0(0x34) Draw Shaded Textured Triangle */
 void drawTri34() {
+    PROFILE_SCOPE(profiler::Zone::GPUTexturedTri);
+
     Vertex v[3];
 
     for (int i = 0; i < 3; i++) {
@@ -545,6 +629,8 @@ void drawTri34() {
 
 /* GP0(0x28) Draw Flat Quadrilateral (opaque) */
 void drawQuad28() {
+    PROFILE_SCOPE(profiler::Zone::GPUFlatTri);
+
     const auto color = cmdParam.front(); cmdParam.pop();
 
     const auto v0 = cmdParam.front(); cmdParam.pop();
@@ -560,6 +646,8 @@ void drawQuad28() {
 
 /* GP0(0x2C) Draw Textured Quadrilateral (semi-transparent, blended) */
 void drawQuad2C() {
+    PROFILE_SCOPE(profiler::Zone::GPUTexturedTri);
+
     const auto c = cmdParam.front(); cmdParam.pop();
 
     Vertex v[4];
@@ -588,6 +676,8 @@ void drawQuad2C() {
 
 /* GP0(0x38) Draw Shaded Quadrilateral (opaque) */
 void drawQuad38() {
+    PROFILE_SCOPE(profiler::Zone::GPUShadedTri);
+
     const auto c0 = cmdParam.front(); cmdParam.pop();
     const auto v0 = cmdParam.front(); cmdParam.pop();
     const auto c1 = cmdParam.front(); cmdParam.pop();
@@ -605,6 +695,8 @@ void drawQuad38() {
 
 /* GP0(0x3E) Draw Shaded Textured Quadrilateral */
 void drawQuad3E() {
+    PROFILE_SCOPE(profiler::Zone::GPUTexturedTri);
+
     Vertex v[4];
 
     for (int i = 0; i < 4; i++) {
@@ -632,6 +724,8 @@ void drawQuad3E() {
 
 /* GP0(0x60) Draw Flat Rectangle (variable) */
 void drawRect60() {
+    PROFILE_SCOPE(profiler::Zone::GPUFlatRect);
+
     const auto c = cmdParam.front(); cmdParam.pop();
     const auto v = cmdParam.front(); cmdParam.pop();
 
@@ -646,6 +740,8 @@ void drawRect60() {
 
 /* GP0(0x65) Draw Textured Rectangle (variable, opaque) */
 void drawRect65() {
+    PROFILE_SCOPE(profiler::Zone::GPUTexturedRect);
+
     const auto c = cmdParam.front(); cmdParam.pop();
     const auto v = cmdParam.front(); cmdParam.pop();
     const auto t = cmdParam.front(); cmdParam.pop();
@@ -663,6 +759,8 @@ void drawRect65() {
 
 /* GP0(0x68) Draw Flat Rectangle (1x1) */
 void drawRect68() {
+    PROFILE_SCOPE(profiler::Zone::GPUFlatRect);
+
     const auto c = cmdParam.front(); cmdParam.pop();
     const auto v = cmdParam.front(); cmdParam.pop();
 
@@ -675,6 +773,8 @@ void drawRect68() {
 
 /* GP0(0x74) Draw Textured Rectangle (8x8, opaque) */
 void drawRect74() {
+    PROFILE_SCOPE(profiler::Zone::GPUTexturedRect);
+
     const auto c = cmdParam.front(); cmdParam.pop();
     const auto v = cmdParam.front(); cmdParam.pop();
     const auto t = cmdParam.front(); cmdParam.pop();
@@ -690,6 +790,8 @@ void drawRect74() {
 
 /* GP0(0x78) Draw Flat Rectangle (8x8) */
 void drawRect78() {
+    PROFILE_SCOPE(profiler::Zone::GPUFlatRect);
+
     const auto c = cmdParam.front(); cmdParam.pop();
     const auto v = cmdParam.front(); cmdParam.pop();
 
@@ -702,6 +804,8 @@ void drawRect78() {
 
 /* GP0(0x7C) Draw Textured Rectangle (16x16, opaque) */
 void drawRect7C() {
+    PROFILE_SCOPE(profiler::Zone::GPUTexturedRect);
+
     const auto c = cmdParam.front(); cmdParam.pop();
     const auto v = cmdParam.front(); cmdParam.pop();
     const auto t = cmdParam.front(); cmdParam.pop();
@@ -717,6 +821,8 @@ void drawRect7C() {
 
 /* GP0(0xA0) Copy Rectangle (CPU->VRAM) */
 void copyCPUToVRAM() {
+    PROFILE_SCOPE(profiler::Zone::GPUCopy);
+
     const auto coords = cmdParam.front(); cmdParam.pop();
     const auto dims   = cmdParam.front(); cmdParam.pop();
 
@@ -736,6 +842,8 @@ void copyCPUToVRAM() {
 
 /* GP0(0xC0) Copy Rectangle (VRAM->CPU) */
 void copyVRAMToCPU() {
+    PROFILE_SCOPE(profiler::Zone::GPUCopy);
+
     const auto coords = cmdParam.front(); cmdParam.pop();
     const auto dims   = cmdParam.front(); cmdParam.pop();
 
@@ -755,6 +863,8 @@ void copyVRAMToCPU() {
 
 /* GP0(0x80) Copy Rectangle (VRAM->VRAM) */
 void copyVRAMToVRAM() {
+    PROFILE_SCOPE(profiler::Zone::GPUCopy);
+
     const auto srcCoord = cmdParam.front(); cmdParam.pop();
     const auto dstCoord = cmdParam.front(); cmdParam.pop();
     const auto dims     = cmdParam.front(); cmdParam.pop();
@@ -785,6 +895,8 @@ void copyVRAMToVRAM() {
         dstCopyInfo.cx++;
 
         if (srcCopyInfo.cx >= srcCopyInfo.xMax) {
+            checkVRAMWrite(dstCopyInfo.xMin, dstCopyInfo.cy, dstCopyInfo.cx - dstCopyInfo.xMin);
+
             srcCopyInfo.cy++;
             dstCopyInfo.cy++;
 
@@ -800,6 +912,8 @@ void copyVRAMToVRAM() {
         dstCopyInfo.cx++;
 
         if (srcCopyInfo.cx >= srcCopyInfo.xMax) {
+            checkVRAMWrite(dstCopyInfo.xMin, dstCopyInfo.cy, dstCopyInfo.cx - dstCopyInfo.xMin);
+
             srcCopyInfo.cy++;
             dstCopyInfo.cy++;
 
@@ -814,13 +928,17 @@ void copyVRAMToVRAM() {
 }
 
 void init() {
-    idHBLANK   = scheduler::registerEvent([](int, i64 c) { hblankEvent(c); });
-    idScanline = scheduler::registerEvent([](int, i64 c) { scanlineEvent(c); });
+    idVBLANK = scheduler::registerEvent([](int param, i64) { vblankEvent(param); });
 
     vram.resize(VRAM_WIDTH * VRAM_HEIGHT);
 
-    scheduler::addEvent(idHBLANK, 0, CYCLES_PER_HDRAW);
-    scheduler::addEvent(idScanline, 0, CYCLES_PER_SCANLINE);
+#ifdef MARI_X86
+    fillSpan = simd::select(simd::Kernel<decltype(fillSpan)>{fillSpanScalar, fillSpanSSE41, fillSpanAVX2, fillSpanAVX512});
+#else
+    fillSpan = simd::select(simd::Kernel<decltype(fillSpan)>{fillSpanScalar});
+#endif
+
+    scheduler::addEvent(idVBLANK, VBLANKEvent::Start, SCANLINES_PER_VDRAW * CYCLES_PER_SCANLINE);
 }
 
 u32 readGPUREAD() {
@@ -1078,6 +1196,8 @@ void writeGP0(u32 data) {
             cmdParam.push(data);
 
             if (!--argCount) {
+                tracer::Scope traceScope("gpu", "gp0", "cmd", cmd);
+
                 switch (cmd) {
                     case 0x02: fillRect(); break;
                     case 0x20:
@@ -1156,6 +1276,8 @@ void writeGP0(u32 data) {
             break;
         case GPUState::CopyRectangle:
             {
+                PROFILE_SCOPE(profiler::Zone::GPUCopy);
+
                 auto &c = dstCopyInfo;
 
                 ////std::printf("[GPU:GP0   ] [0x%08X] = 0x%04X\n", c.cx + 1024 * c.cy, data & 0xFFFF);
@@ -1165,6 +1287,8 @@ void writeGP0(u32 data) {
                 c.cx++;
 
                 if (c.cx >= c.xMax) {
+                    checkVRAMWrite(c.xMin, c.cy, c.xMax - c.xMin);
+
                     c.cy++;
 
                     c.cx = c.xMin;
@@ -1177,12 +1301,18 @@ void writeGP0(u32 data) {
                 c.cx++;
 
                 if (c.cx >= c.xMax) {
+                    checkVRAMWrite(c.xMin, c.cy, c.xMax - c.xMin);
+
                     c.cy++;
 
                     c.cx = c.xMin;
                 }
 
-                if (!--argCount) state = GPUState::ReceiveCommand;
+                if (!--argCount) {
+                    if (c.cx != c.xMin) checkVRAMWrite(c.xMin, c.cy, c.cx - c.xMin); // Incomplete last row
+
+                    state = GPUState::ReceiveCommand;
+                }
             }
             break;
         default:
@@ -1191,7 +1321,12 @@ void writeGP0(u32 data) {
 }
 
 u32 readStatus() {
-    return gpustat;
+    const auto line = getLine();
+
+    /* Odd line in VDRAW */
+    const bool isOddLine = (line < SCANLINES_PER_VDRAW) && (line & 1);
+
+    return (gpustat & ~(1u << 31)) | ((u32)isOddLine << 31);
 }
 
 void writeGP1(u32 data) {
@@ -15,4 +15,7 @@ void writeGP1(u32 data);
 u32 readGPUREAD();
 u32 readStatus();
 
+i64 getHBLANKCount(i64 t);
+i64 getHBLANKTime(i64 n);
+
 }
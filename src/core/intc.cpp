@@ -8,6 +8,7 @@
 #include <cassert>
 #include <cstdio>
 
+#include "tracer.hpp"
 #include "cpu/cop0.hpp"
 
 namespace ps::intc {
@@ -60,6 +61,8 @@ void writeStat(u16 data) {
 void sendInterrupt(Interrupt i) {
     //std::printf("[INTC      ] %s interrupt request\n", intNames[static_cast<int>(i)]);
 
+    tracer::instant("irq", intNames[static_cast<int>(i)]);
+
     iSTAT |= 1 << static_cast<int>(i);
 
     checkInterrupt();
@@ -0,0 +1,254 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "movie.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace ps::movie {
+
+/* Movie file layout (little endian):
+ *
+ * "MMOV", version (u32)
+ * BIOS hash (u64, FNV-1a)
+ * BIOS, ISO and EXE path (u16 length + characters each, EXE path may be empty)
+ * Frame count (u64)
+ * Input change count (u32), input changes: frame (u32), buttons (u16)
+ */
+
+/* --- Movie constants --- */
+
+constexpr u32 MOVIE_VERSION = 1;
+
+/* Input change */
+struct Entry {
+    u32 frame;
+    u16 input;
+};
+
+enum class Mode {
+    Off,
+    Record,
+    Playback,
+};
+
+Mode mode = Mode::Off;
+
+const char *recordPath = NULL;
+
+u64 biosHash;
+
+std::string biosPath, isoPath, exePath;
+
+std::vector<Entry> entries;
+size_t entryIdx = 0;
+
+u64 frameCount;
+
+u16 currentInput = 0;
+
+/* Returns 64-bit FNV-1a hash of a file */
+u64 hashFile(const char *path) {
+    auto file = std::fopen(path, "rb");
+
+    if (!file) return 0;
+
+    u64 hash = 0xCBF29CE484222325;
+
+    u8 buf[4096];
+
+    size_t size;
+
+    while ((size = std::fread(buf, 1, sizeof(buf), file))) {
+        for (size_t i = 0; i < size; i++) {
+            hash ^= buf[i];
+            hash *= 0x100000001B3;
+        }
+    }
+
+    std::fclose(file);
+
+    return hash;
+}
+
+/* Returns file name of a path */
+std::string getFileName(const std::string &path) {
+    const auto pos = path.find_last_of("/\\");
+
+    return (pos == std::string::npos) ? path : path.substr(pos + 1);
+}
+
+void writeString(std::FILE *file, const std::string &str) {
+    const u16 size = str.size();
+
+    std::fwrite(&size, sizeof(size), 1, file);
+    std::fwrite(str.data(), 1, size, file);
+}
+
+bool readString(std::FILE *file, std::string &str) {
+    u16 size;
+
+    if (std::fread(&size, sizeof(size), 1, file) != 1) return false;
+
+    str.resize(size);
+
+    return std::fread(str.data(), 1, size, file) == size;
+}
+
+/* Writes recorded movie */
+void save() {
+    auto file = std::fopen(recordPath, "wb");
+
+    if (!file) {
+        std::printf("[Movie     ] Unable to open file \"%s\"\n", recordPath);
+
+        return;
+    }
+
+    const u32 entryCount = entries.size();
+
+    std::fwrite("MMOV", 1, 4, file);
+    std::fwrite(&MOVIE_VERSION, sizeof(MOVIE_VERSION), 1, file);
+    std::fwrite(&biosHash, sizeof(biosHash), 1, file);
+
+    writeString(file, biosPath);
+    writeString(file, isoPath);
+    writeString(file, exePath);
+
+    std::fwrite(&frameCount, sizeof(frameCount), 1, file);
+    std::fwrite(&entryCount, sizeof(entryCount), 1, file);
+
+    for (auto &e : entries) {
+        std::fwrite(&e.frame, sizeof(e.frame), 1, file);
+        std::fwrite(&e.input, sizeof(e.input), 1, file);
+    }
+
+    std::fclose(file);
+
+    std::printf("[Movie     ] Recorded %llu frames to \"%s\"\n", (unsigned long long)frameCount, recordPath);
+}
+
+/* Loads a movie, checks if it was recorded with the same BIOS and disc */
+void load(const char *path, const Config &config) {
+    auto file = std::fopen(path, "rb");
+
+    if (!file) {
+        std::printf("[Movie     ] Unable to open file \"%s\"\n", path);
+
+        exit(0);
+    }
+
+    char magic[4];
+    u32  version, entryCount;
+
+    bool isOK = (std::fread(magic, 1, 4, file) == 4) && !std::memcmp(magic, "MMOV", 4);
+
+    isOK = isOK && (std::fread(&version, sizeof(version), 1, file) == 1) && (version == MOVIE_VERSION);
+    isOK = isOK && (std::fread(&biosHash, sizeof(biosHash), 1, file) == 1);
+    isOK = isOK && readString(file, biosPath) && readString(file, isoPath) && readString(file, exePath);
+    isOK = isOK && (std::fread(&frameCount, sizeof(frameCount), 1, file) == 1);
+    isOK = isOK && (std::fread(&entryCount, sizeof(entryCount), 1, file) == 1);
+
+    for (u32 i = 0; isOK && (i < entryCount); i++) {
+        Entry e;
+
+        isOK = (std::fread(&e.frame, sizeof(e.frame), 1, file) == 1) && (std::fread(&e.input, sizeof(e.input), 1, file) == 1);
+
+        entries.push_back(e);
+    }
+
+    std::fclose(file);
+
+    if (!isOK) {
+        std::printf("[Movie     ] \"%s\" is not a valid movie file\n", path);
+
+        exit(0);
+    }
+
+    if (hashFile(config.biosPath) != biosHash) {
+        std::printf("[Movie     ] Warning: movie was recorded with a different BIOS (\"%s\")\n", biosPath.c_str());
+    }
+
+    if (getFileName(config.isoPath) != getFileName(isoPath)) {
+        std::printf("[Movie     ] Warning: movie was recorded with disc \"%s\"\n", isoPath.c_str());
+    }
+
+    if (getFileName(config.exePath ? config.exePath : "") != getFileName(exePath)) {
+        std::printf("[Movie     ] Warning: movie was recorded with EXE \"%s\"\n", exePath.c_str());
+    }
+
+    std::printf("[Movie     ] Playing back %llu frames from \"%s\"\n", (unsigned long long)frameCount, path);
+}
+
+void init(const Config &config) {
+    if (config.moviePlayPath && config.movieRecordPath) {
+        std::printf("[Movie     ] Can't record and play back a movie at the same time\n");
+
+        exit(0);
+    }
+
+    /* Both would drive the controller */
+    if (config.moviePlayPath && config.inputPath) {
+        std::printf("[Movie     ] Can't play back a movie and an input script at the same time\n");
+
+        exit(0);
+    }
+
+    if (config.moviePlayPath) {
+        load(config.moviePlayPath, config);
+
+        mode = Mode::Playback;
+    } else if (config.movieRecordPath) {
+        recordPath = config.movieRecordPath;
+
+        biosHash = hashFile(config.biosPath);
+
+        biosPath = config.biosPath;
+        isoPath  = config.isoPath;
+        exePath  = (config.exePath) ? config.exePath : "";
+
+        frameCount = 0;
+
+        std::atexit(save);
+
+        mode = Mode::Record;
+    }
+}
+
+/* Records or replaces input for a frame */
+u16 getInput(u64 frame, u16 input) {
+    switch (mode) {
+        case Mode::Record:
+            if (entries.empty() || (input != currentInput)) {
+                entries.push_back(Entry{(u32)frame, input});
+
+                currentInput = input;
+            }
+
+            frameCount = frame;
+
+            return input;
+        case Mode::Playback:
+            if (frame > frameCount) {
+                std::printf("[Movie     ] Playback finished after %llu frames\n", (unsigned long long)frameCount);
+
+                mode = Mode::Off;
+
+                return input;
+            }
+
+            while ((entryIdx < entries.size()) && (entries[entryIdx].frame <= frame)) currentInput = entries[entryIdx++].input;
+
+            return currentInput;
+        default:
+            return input;
+    }
+}
+
+}
@@ -0,0 +1,16 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include "Mari.hpp"
+
+namespace ps::movie {
+
+void init(const Config &config);
+
+u16 getInput(u64 frame, u16 input);
+
+}
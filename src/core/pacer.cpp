@@ -0,0 +1,108 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "pacer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace ps::pacer {
+
+using Clock = std::chrono::steady_clock;
+
+/* --- Frame pacer constants --- */
+
+constexpr double PRESENT_RATE = 60.0; // Maximum presentation rate while skipping frames
+
+constexpr auto SPIN_TIME = std::chrono::microseconds(1500); // Busy-wait this long before a deadline
+constexpr int  MAX_LAG   = 4; // Frames, resynchronize if we fall further behind
+
+bool isThrottled = true;
+
+Clock::duration framePeriod;
+
+Clock::time_point deadline; // Next frame deadline
+Clock::time_point lastPresent;
+
+int maxSkip = 0; // Maximum number of consecutive frames that aren't presented
+int skipped = 0;
+
+/* Parses the speed ("ntsc", "pal", "<n>x" for n times NTSC, "max" for unthrottled) */
+void init(const char *speed, int maxSkip) {
+    double rate = NTSC_RATE;
+
+    if (speed && !std::strcmp(speed, "max")) {
+        isThrottled = false;
+    } else if (speed && !std::strcmp(speed, "pal")) {
+        rate = PAL_RATE;
+    } else if (speed && std::strcmp(speed, "ntsc")) {
+        char *end;
+
+        const auto factor = std::strtod(speed, &end);
+
+        if ((end == speed) || !((*end == '\0') || !std::strcmp(end, "x")) || !(factor > 0.0)) {
+            std::printf("[Pacer     ] Invalid speed \"%s\" (ntsc, pal, <n>x, max)\n", speed);
+
+            exit(0);
+        }
+
+        rate *= factor;
+    }
+
+    pacer::maxSkip = (maxSkip > 0) ? maxSkip : 0;
+
+    framePeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+
+    deadline = lastPresent = Clock::now();
+
+    if (isThrottled) {
+        std::printf("[Pacer     ] Target: %.3f fps, frame skip: %d\n", rate, pacer::maxSkip);
+    } else {
+        std::printf("[Pacer     ] Target: unthrottled, frame skip: %d\n", pacer::maxSkip);
+    }
+}
+
+/* Sleeps until shortly before the deadline, then spins (sleep granularity is too coarse for precise pacing) */
+void waitUntil(Clock::time_point t) {
+    if ((t - Clock::now()) > SPIN_TIME) std::this_thread::sleep_until(t - SPIN_TIME);
+
+    while (Clock::now() < t) std::this_thread::yield();
+}
+
+bool endFrame() {
+    auto now = Clock::now();
+
+    if (isThrottled) {
+        deadline += framePeriod;
+
+        if ((now - deadline) > (MAX_LAG * framePeriod)) {
+            deadline = now; // Too slow (or paused), don't try to catch up
+        } else {
+            waitUntil(deadline);
+
+            now = Clock::now();
+        }
+    }
+
+    /* Only skip frames if they come in faster than they can be displayed */
+    const auto presentPeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / PRESENT_RATE));
+
+    if ((skipped < maxSkip) && ((now - lastPresent) < presentPeriod)) {
+        skipped++;
+
+        return false;
+    }
+
+    skipped = 0;
+
+    lastPresent = now;
+
+    return true;
+}
+
+}
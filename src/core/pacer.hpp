@@ -0,0 +1,22 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include "../common/types.hpp"
+
+namespace ps::pacer {
+
+/* --- Frame rates --- */
+
+constexpr double NTSC_RATE = 59.826; // Hz
+constexpr double PAL_RATE  = 49.761; // Hz
+
+void init(const char *speed, int maxSkip);
+
+/* Waits for the next frame deadline, returns true if the frame should be presented */
+bool endFrame();
+
+}
@@ -0,0 +1,124 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "profiler.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace ps::profiler {
+
+#ifdef MARI_PROFILE
+
+using Clock = std::chrono::steady_clock;
+
+const char *zoneNames[static_cast<int>(Zone::NumZones)] = {
+    "other",
+    "cpu",
+    "bus_io",
+    "dma_mdec_in", "dma_mdec_out", "dma_gpu", "dma_cdrom", "dma_spu", "dma_pio", "dma_otc",
+    "gpu_fill",
+    "gpu_flat_tri",
+    "gpu_shaded_tri",
+    "gpu_textured_tri",
+    "gpu_flat_rect",
+    "gpu_textured_rect",
+    "gpu_copy",
+    "gte",
+    "spu",
+    "cdrom_read",
+};
+
+ZoneStats stats[static_cast<int>(Zone::NumZones)];
+
+Zone current = Zone::Other;
+u64  lastTick;
+
+std::FILE *file = NULL;
+
+u64 frame;
+
+/* Host time and TSC at the start of the current frame */
+Clock::time_point frameStart;
+u64 frameStartTick;
+
+void close() {
+    if (file) std::fclose(file);
+
+    file = NULL;
+}
+
+void init(const char *path) {
+    if (!path) return;
+
+    file = std::fopen(path, "w");
+
+    if (!file) {
+        std::printf("[Profiler  ] Unable to open file \"%s\"\n", path);
+
+        exit(0);
+    }
+
+    std::atexit(close);
+
+    std::memset(&stats, 0, sizeof(stats));
+
+    frame = 0;
+
+    frameStart = Clock::now();
+    frameStartTick = lastTick = readTSC();
+
+    std::printf("[Profiler  ] Writing per-frame profile to \"%s\"\n", path);
+}
+
+/* Writes one JSON object for the last frame, resets statistics */
+void endFrame() {
+    if (!file) return;
+
+    /* Charge pending time to the current zone */
+    switchZone(current);
+
+    const auto now = Clock::now();
+    const auto nowTick = lastTick;
+
+    const auto frameNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - frameStart).count();
+
+    /* Calibrate ticks against the host clock once per frame */
+    const auto nsPerTick = (nowTick != frameStartTick) ? (double)frameNs / (double)(nowTick - frameStartTick) : 0.0;
+
+    std::fprintf(file, "{\"frame\":%llu,\"wall_ns\":%lld,\"zones\":{", (unsigned long long)frame, (long long)frameNs);
+
+    for (int i = 0; i < static_cast<int>(Zone::NumZones); i++) {
+        const auto &s = stats[i];
+
+        std::fprintf(
+            file, "%s\"%s\":{\"calls\":%llu,\"ns\":%llu,\"cycles\":%llu}", (i) ? "," : "", zoneNames[i],
+            (unsigned long long)s.calls, (unsigned long long)(nsPerTick * s.ticks), (unsigned long long)s.cycles
+        );
+    }
+
+    std::fprintf(file, "}}\n");
+
+    std::memset(&stats, 0, sizeof(stats));
+
+    frame++;
+
+    frameStart = now;
+    frameStartTick = nowTick;
+}
+
+#else
+
+void init(const char *path) {
+    if (path) std::printf("[Profiler  ] Profiler not compiled in, rebuild with -DMARI_PROFILE=ON\n");
+}
+
+void endFrame() {}
+
+#endif
+
+}
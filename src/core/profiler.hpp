@@ -0,0 +1,108 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include "../common/types.hpp"
+
+#ifdef MARI_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+namespace ps::profiler {
+
+/* Profiler zones */
+enum class Zone {
+    Other, // Frontend, scheduler and everything not covered by a zone
+    CPU,
+    BusIO,
+    DMA0, DMA1, DMA2, DMA3, DMA4, DMA5, DMA6, // One zone per DMA channel
+    GPUFill,
+    GPUFlatTri,
+    GPUShadedTri,
+    GPUTexturedTri,
+    GPUFlatRect,
+    GPUTexturedRect,
+    GPUCopy,
+    GTE,
+    SPU,
+    CDROMRead,
+    NumZones,
+};
+
+void init(const char *path);
+void endFrame();
+
+#ifdef MARI_PROFILE
+
+/* Per-zone statistics (self time, nested zones are not included).
+ * Emulated cycles are reported by CPU (time slices), DMA (transfer time), GTE (command time), SPU (sample time)
+ * and CDROMRead (sector time). They overlap (devices run in parallel with the CPU, GTE commands are part of CPU time),
+ * so they don't add up to the emulated time of a frame.
+ */
+struct ZoneStats {
+    u64 calls;
+    u64 ticks;
+    u64 cycles; // Emulated cycles, 0 for zones that don't report any
+};
+
+extern ZoneStats stats[static_cast<int>(Zone::NumZones)];
+
+extern Zone current;
+extern u64  lastTick;
+
+/* Returns a cheap, monotonic timestamp */
+inline u64 readTSC() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+/* Charges the time since the last zone switch to the current zone */
+inline void switchZone(Zone z) {
+    const auto now = readTSC();
+
+    stats[static_cast<int>(current)].ticks += now - lastTick;
+
+    lastTick = now;
+    current  = z;
+}
+
+/* Scoped zone timer */
+struct Scope {
+    Scope(Zone z) : parent(current) {
+        switchZone(z);
+
+        stats[static_cast<int>(z)].calls++;
+    }
+
+    ~Scope() {
+        switchZone(parent);
+    }
+
+    Zone parent;
+};
+
+inline void addCycles(Zone z, i64 c) {
+    stats[static_cast<int>(z)].cycles += c;
+}
+
+#define PROFILE_SCOPE(zone) ps::profiler::Scope profilerScope(zone)
+#define PROFILE_CYCLES(zone, c) ps::profiler::addCycles(zone, c)
+
+#else
+
+#define PROFILE_SCOPE(zone)
+#define PROFILE_CYCLES(zone, c)
+
+#endif
+
+}
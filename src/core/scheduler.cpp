@@ -6,11 +6,12 @@
 #include "scheduler.hpp"
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cstdio>
-#include <deque>
-#include <queue>
-#include <vector>
+#include <cstdlib>
+
+#include "cpu/cpu.hpp"
 
 namespace ps::scheduler {
 
@@ -18,27 +19,38 @@ namespace ps::scheduler {
 
 constexpr i64 MAX_RUN_CYCLES = 64;
 
-/* Scheduler event */
+constexpr int MAX_FUNCS  = 16; // Registered callbacks, 8 are used by the devices
+constexpr int MAX_EVENTS = 64; // Pending events, one bit each in activeEvents
+
+/* Pending event */
 struct Event {
+    EventFunc func;
+
     u64 id;
 
     int param;
     i64 cyclesUntilEvent;
 };
 
-std::deque<Event> events;     // Event queue
-std::queue<Event> nextEvents;
+/* Event slots, devices have at most a few events pending at a time */
+Event events[MAX_EVENTS];
+
+u64 activeEvents; // One bit per used slot
+
+EventFunc registeredFuncs[MAX_FUNCS];
 
-std::vector<std::function<void(int, i64)>> registeredFuncs;
+int funcCount;
 
 i64 cycleCount, cyclesUntilNextEvent;
 
+bool isProcessing; // True while event callbacks run
+
 /* Finds the next event */
 void reschedule() {
     auto nextEvent = INT64_MAX;
 
-    for (auto &event : events) {
-        if (event.cyclesUntilEvent < nextEvent) nextEvent = event.cyclesUntilEvent;
+    for (auto mask = activeEvents; mask; mask &= mask - 1) {
+        nextEvent = std::min(nextEvent, events[std::countr_zero(mask)].cyclesUntilEvent);
     }
 
     cyclesUntilNextEvent = nextEvent;
@@ -47,73 +59,112 @@ void reschedule() {
 void init() {
     cycleCount = 0;
 
-    cyclesUntilNextEvent = INT64_MAX;
-}
-
-void flush() {
-    if (nextEvents.empty()) return reschedule();
-
-    while (!nextEvents.empty()) { events.push_back(nextEvents.front()); nextEvents.pop(); }
+    activeEvents = 0;
 
-    reschedule();
+    cyclesUntilNextEvent = INT64_MAX;
 }
 
 /* Registers an event, returns event ID */
-u64 registerEvent(std::function<void(int, i64)> func) {
-    static u64 idPool;
+u64 registerEvent(EventFunc func) {
+    if (funcCount == MAX_FUNCS) {
+        std::printf("[Scheduler ] Too many registered events (MAX_FUNCS = %d)\n", MAX_FUNCS);
 
-    registeredFuncs.push_back(func);
+        exit(1);
+    }
 
-    return idPool++;
+    registeredFuncs[funcCount] = func;
+
+    return funcCount++;
 }
 
-/* Adds a scheduler event */
+/* Adds a scheduler event.
+ * processEvents() runs after the CPU slice, events added by the CPU are relative to its position in the slice
+ */
 void addEvent(u64 id, int param, i64 cyclesUntilEvent) {
     assert(cyclesUntilEvent >= 0);
 
+    if (!isProcessing) cyclesUntilEvent += std::max((i64)0, now() - cycleCount);
+
     //std::printf("[Scheduler ] Adding event %llu, cycles until event: %lld\n", id, cyclesUntilEvent);
 
-    nextEvents.emplace(Event{id, param, cyclesUntilEvent});
+    if (activeEvents == ~0ull) {
+        std::printf("[Scheduler ] Too many pending events\n");
+
+        exit(1);
+    }
+
+    const auto slot = std::countr_one(activeEvents);
+
+    events[slot] = Event{registeredFuncs[id], id, param, cyclesUntilEvent};
+
+    activeEvents |= 1ull << slot;
+
+    cyclesUntilNextEvent = std::min(cyclesUntilNextEvent, cyclesUntilEvent);
 }
 
 /* Removes all scheduler events of a certain ID */
 void removeEvent(u64 id) {
-    for (auto event = events.begin(); event != events.end();) {
-        if (event->id == id) {
-            event = events.erase(event);
-        } else {
-            event++;
-        }
+    for (auto mask = activeEvents; mask; mask &= mask - 1) {
+        const auto slot = std::countr_zero(mask);
+
+        if (events[slot].id == id) activeEvents &= ~(1ull << slot);
     }
+
+    reschedule();
 }
 
 void processEvents(i64 elapsedCycles) {
-    assert(!events.empty());
+    cycleCount += elapsedCycles;
 
-    cyclesUntilNextEvent -= elapsedCycles;
+    isProcessing = true;
 
-    for (auto event = events.begin(); event != events.end();) {
-        event->cyclesUntilEvent -= elapsedCycles;
+    /* Count down first, events added by the callbacks start counting at the next call */
+    u64 expiredEvents = 0;
 
-        assert(event->cyclesUntilEvent >= 0);
+    for (auto mask = activeEvents; mask; mask &= mask - 1) {
+        const auto slot = std::countr_zero(mask);
 
-        if (!event->cyclesUntilEvent) {
-            const auto id = event->id;
-            const auto param = event->param;
-            //const auto cyclesUntilEvent = event->cyclesUntilEvent;
+        auto &event = events[slot];
 
-            event = events.erase(event);
+        event.cyclesUntilEvent -= elapsedCycles;
 
-            registeredFuncs[id](param, 0);
-        } else {
-            event++;
-        }
+        /* Events added during the slice can expire late */
+        if (event.cyclesUntilEvent <= 0) expiredEvents |= 1ull << slot;
     }
+
+    /* Slots are freed right before their callback runs, pending expired events can't be overwritten */
+    for (; expiredEvents; expiredEvents &= expiredEvents - 1) {
+        const auto slot = std::countr_zero(expiredEvents);
+
+        const auto bit = 1ull << slot;
+
+        /* Removed by an earlier callback (the slot may have been reused already) */
+        if (!(activeEvents & bit) || (events[slot].cyclesUntilEvent > 0)) continue;
+
+        activeEvents &= ~bit;
+
+        events[slot].func(events[slot].param, -events[slot].cyclesUntilEvent);
+    }
+
+    isProcessing = false;
+
+    reschedule();
 }
 
 i64 getRunCycles() {
     return std::min((i64)MAX_RUN_CYCLES, cyclesUntilNextEvent);
 }
 
+/* Returns the number of elapsed cycles */
+i64 getCycleCount() {
+    return cycleCount;
 }
 
+/* Returns the current time stamp (CPU time, never goes backwards).
+ * Devices remember when they were last synced and catch up to this on access
+ */
+i64 now() {
+    return cpu::getTime();
+}
+
+}
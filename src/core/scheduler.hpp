@@ -5,17 +5,16 @@
 
 #pragma once
 
-#include <functional>
-
 #include "../common/types.hpp"
 
 namespace ps::scheduler {
 
-void init();
+/* Event callback, called with the event parameter */
+using EventFunc = void (*)(int param, i64 cyclesLate);
 
-void flush();
+void init();
 
-u64 registerEvent(std::function<void(int, i64)> func);
+u64 registerEvent(EventFunc func);
 
 void addEvent(u64 id, int param, i64 cyclesUntilEvent);
 void removeEvent(u64 id);
@@ -23,4 +22,8 @@ void processEvents(i64 elapsedCycles);
 
 i64 getRunCycles();
 
+i64 getCycleCount();
+
+i64 now();
+
 }
@@ -0,0 +1,73 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "simd.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace ps::simd {
+
+constexpr const char *levelNames[] = {"scalar", "sse4.1", "avx2", "avx512"};
+
+Level hostLevel = Level::Scalar;
+Level level     = Level::Scalar;
+
+/* Detects the highest level supported by the host CPU (and OS) */
+Level detect() {
+#ifdef MARI_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return Level::AVX512;
+    if (__builtin_cpu_supports("avx2")) return Level::AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return Level::SSE41;
+#endif
+
+    return Level::Scalar;
+}
+
+/* Detects host features, optionally caps the active level (for validating kernels against the scalar reference) */
+void init(const char *level) {
+    hostLevel = detect();
+
+    simd::level = hostLevel;
+
+    if (level) {
+        int i = 0;
+
+        for (; i < (int)(sizeof(levelNames) / sizeof(levelNames[0])); i++) {
+            if (!std::strcmp(level, levelNames[i])) break;
+        }
+
+        if (i == (int)(sizeof(levelNames) / sizeof(levelNames[0]))) {
+            std::printf("[SIMD      ] Unknown level \"%s\" (scalar, sse4.1, avx2, avx512)\n", level);
+
+            exit(0);
+        }
+
+        if ((Level)i > hostLevel) {
+            std::printf("[SIMD      ] Host doesn't support %s\n", level);
+        } else {
+            simd::level = (Level)i;
+        }
+    }
+
+    std::printf("[SIMD      ] Host: %s, using: %s\n", getName(hostLevel), getName(simd::level));
+}
+
+Level getLevel() {
+    return level;
+}
+
+Level getHostLevel() {
+    return hostLevel;
+}
+
+const char *getName(Level level) {
+    return levelNames[(int)level];
+}
+
+}
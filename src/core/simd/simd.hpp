@@ -0,0 +1,59 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "../../common/types.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MARI_X86 1
+
+#include <immintrin.h>
+
+/* Compiles a single function for a given instruction set, independent of -march */
+#define MARI_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace ps::simd {
+
+/* Instruction set levels, ordered */
+enum class Level {
+    Scalar,
+    SSE41,
+    AVX2,
+    AVX512,
+};
+
+/* Kernel implementations, NULL if a level isn't implemented */
+template<typename Fn>
+struct Kernel {
+    Fn scalar;
+    Fn sse41  = NULL;
+    Fn avx2   = NULL;
+    Fn avx512 = NULL;
+};
+
+void init(const char *level);
+
+Level getLevel();
+Level getHostLevel();
+
+const char *getName(Level level);
+
+/* Returns the best implementation for the active level, the scalar reference is always available */
+template<typename Fn>
+Fn select(const Kernel<Fn> &kernel) {
+    const auto level = getLevel();
+
+    if ((level >= Level::AVX512) && kernel.avx512) return kernel.avx512;
+    if ((level >= Level::AVX2  ) && kernel.avx2  ) return kernel.avx2;
+    if ((level >= Level::SSE41 ) && kernel.sse41 ) return kernel.sse41;
+
+    return kernel.scalar;
+}
+
+}
@@ -15,6 +15,7 @@
 #include "gauss.hpp"
 
 #include "../intc.hpp"
+#include "../profiler.hpp"
 #include "../scheduler.hpp"
 
 namespace ps::spu {
@@ -23,6 +24,8 @@ namespace ps::spu {
 
 constexpr i64 SPU_RATE = 0x300;
 
+constexpr i64 SAMPLES_PER_EVENT = 32; // Samples are generated in batches, accesses catch up first (one sample if IRQs are enabled)
+
 constexpr u32 SPU_BASE = 0x1F801C00;
 constexpr u32 RAM_SIZE = 0x80000;
 
@@ -151,6 +154,8 @@ i16 mvoll, mvolr;
 
 u64 idStep;
 
+i64 lastSync = 0; // Time stamp of the last generated sample
+
 /* Returns true if address is in range [base;size] */
 bool inRange(u64 addr, u64 base, u64 size) {
     return (addr >= base) && (addr < (base + size));
@@ -271,6 +276,9 @@ void stepADSR(int vID) {
 
 /* Steps the SPU, calculates current sample */
 void step() {
+    PROFILE_SCOPE(profiler::Zone::SPU);
+    PROFILE_CYCLES(profiler::Zone::SPU, SPU_RATE);
+
     i32 sl = 0;
     i32 sr = 0;
 
@@ -363,12 +371,32 @@ void step() {
         }
     }
 
-    sound[2 * soundIdx + 0] = (sl * mvoll) >> 15;
-    sound[2 * soundIdx + 1] = (sr * mvolr) >> 15;
+    /* Drop samples if nobody saves them */
+    if (soundIdx < 2048) {
+        sound[2 * soundIdx + 0] = (sl * mvoll) >> 15;
+        sound[2 * soundIdx + 1] = (sr * mvolr) >> 15;
+
+        soundIdx++;
+    }
+}
+
+/* Generates all samples up to the current time stamp */
+void sync() {
+    for (const auto now = scheduler::now(); (now - lastSync) >= SPU_RATE; lastSync += SPU_RATE) step();
+}
 
-    soundIdx++;
+/* Schedules the next sample event on a sample boundary, SPU IRQs have to be raised on the exact sample */
+void scheduleStep() {
+    const auto samples = (spucnt.irqen) ? 1 : SAMPLES_PER_EVENT;
 
-    scheduler::addEvent(idStep, 0, SPU_RATE);
+    scheduler::addEvent(idStep, 0, lastSync + samples * SPU_RATE - scheduler::now());
+}
+
+/* Handles SPU sample events */
+void stepEvent() {
+    sync();
+
+    scheduleStep();
 }
 
 /* Handle Key Off event */
@@ -413,13 +441,15 @@ void init() {
 
     ram.resize(RAM_SIZE);
 
-    idStep = scheduler::registerEvent([](int, i64) { step(); });
+    idStep = scheduler::registerEvent([](int, i64) { stepEvent(); });
 
-    scheduler::addEvent(idStep, 0, SPU_RATE);
+    scheduleStep();
 }
 
 /* Write audio to file */
 void save() {
+    sync();
+
     std::ofstream file;
 
     file.open("snd.bin", std::ios::out | std::ios::binary | std::ios::app);
@@ -445,7 +475,9 @@ u16 readRAM(u32 addr) {
 void writeRAM(u16 data) {
     assert(caddr < RAM_SIZE);
 
-    std::printf("[SPU       ] [0x%05X] = 0x%04X\n", caddr, data);
+    sync();
+
+    //std::printf("[SPU       ] [0x%05X] = 0x%04X\n", caddr, data);
 
     std::memcpy(&ram[caddr], &data, 2);
 
@@ -457,6 +489,8 @@ void writeRAM(u16 data) {
 u16 read(u32 addr) {
     u16 data;
 
+    sync();
+
     if (addr < static_cast<u32>(SPUReg::MVOLL)) { // SPU voices
         const auto vID = (addr >> 4) & 0x1F;
 
@@ -577,6 +611,8 @@ u16 read(u32 addr) {
 }
 
 void write(u32 addr, u16 data) {
+    sync();
+
     if (addr < static_cast<u32>(SPUReg::MVOLL)) { // SPU voices
         const auto vID = (addr >> 4) & 0x1F;
 
@@ -736,6 +772,15 @@ void write(u32 addr, u16 data) {
             case static_cast<u32>(SPUReg::SPUCNT):
                 std::printf("[SPU       ] 16-bit write @ SPUCNT = 0x%04X\n", data);
 
+                if (spucnt.irqen != (bool)(data & (1 << 6))) {
+                    spucnt.irqen = data & (1 << 6);
+
+                    /* Switch between sample batches and single samples */
+                    scheduler::removeEvent(idStep);
+
+                    scheduleStep();
+                }
+
                 spucnt.cden   = data & (1 << 0);
                 spucnt.exten  = data & (1 << 1);
                 spucnt.cdrev  = data & (1 << 2);
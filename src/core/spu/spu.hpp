@@ -12,6 +12,8 @@ namespace ps::spu {
 void init();
 void save();
 
+void step();
+
 void writeRAM(u16 data);
 
 u16 read(u32 addr);
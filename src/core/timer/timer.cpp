@@ -7,9 +7,12 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 #include "../intc.hpp"
+#include "../scheduler.hpp"
+#include "../gpu/gpu.hpp"
 
 namespace ps::timer {
 
@@ -46,14 +49,18 @@ struct Timer {
     u16 comp;  // T_COMP
 
     // Prescaler
-    u16 subcount;
+    i64 subcount;
     u16 prescaler;
 
     bool isPaused;
+
+    i64 lastSync; // Time stamp the timer was last caught up to
 };
 
 Timer timers[3];
 
+u64 idIRQ[3]; // Scheduler, one event per timer
+
 /* Returns timer ID from address */
 int getTimer(u32 addr) { 
     switch ((addr >> 4) & 0xFF) {
@@ -79,11 +86,129 @@ void sendInterrupt(int tmID) {
     }
 }
 
+/* Returns true if the timer counts HBLANKs */
+bool isHBLANKClock(int tmID) {
+    return (tmID == 1) && (timers[tmID].mode.clks & 1);
+}
+
+/* Returns true if the timer counts at all (the dot clock isn't emulated) */
+bool isCounting(int tmID) {
+    const auto &timer = timers[tmID];
+
+    if (timer.isPaused) return false;
+
+    return !((tmID == 0) && (timer.mode.clks & 1));
+}
+
+/* Returns the number of ticks until the next compare or overflow event */
+u32 getTicksUntilTarget(int tmID) {
+    const auto &timer = timers[tmID];
+
+    const u32 target = (timer.comp > timer.count) ? timer.comp : 0x10000;
+
+    return target - timer.count;
+}
+
+/* Advances a timer by n ticks, jumps from one compare/overflow event to the next */
+void advance(int tmID, i64 n) {
+    auto &timer = timers[tmID];
+
+    while (n) {
+        const auto ticks = getTicksUntilTarget(tmID);
+
+        if (n < ticks) {
+            timer.count += n;
+
+            return;
+        }
+
+        n -= ticks;
+
+        timer.count += ticks;
+
+        if (timer.count & (1 << 16)) {
+            if (timer.mode.ovfe && !timer.mode.ovff) {
+                // Checking OVFF is necessary because timer IRQs are edge-triggered
+                timer.mode.ovff = true;
+
+                sendInterrupt(tmID);
+            }
+        }
+
+        timer.count &= 0xFFFF;
+
+        if (timer.count == timer.comp) {
+            if (timer.mode.cmpe && !timer.mode.equf) {
+                // Checking EQUF is necessary because timer IRQs are edge-triggered
+                timer.mode.equf = true;
+
+                sendInterrupt(tmID);
+            }
+
+            if (timer.mode.zret) timer.count = 0;
+        }
+    }
+}
+
+/* Catches a timer up to the current time stamp */
+void sync(int tmID) {
+    auto &timer = timers[tmID];
+
+    const auto now = scheduler::now();
+    const auto last = timer.lastSync;
+
+    timer.lastSync = now;
+
+    if (!isCounting(tmID)) return;
+
+    if (isHBLANKClock(tmID)) return advance(tmID, gpu::getHBLANKCount(now) - gpu::getHBLANKCount(last));
+
+    timer.subcount += now - last;
+
+    if (timer.subcount <= timer.prescaler) return;
+
+    const auto n = (timer.subcount - 1) / timer.prescaler;
+
+    timer.subcount -= n * timer.prescaler;
+
+    advance(tmID, n);
+}
+
+/* Schedules the next compare/overflow event of a timer, timers are only synced when accessed otherwise */
+void schedule(int tmID) {
+    const auto &timer = timers[tmID];
+
+    scheduler::removeEvent(idIRQ[tmID]);
+
+    /* Nothing to observe until the next access */
+    if (!isCounting(tmID) || !(timer.mode.cmpe || timer.mode.ovfe)) return;
+
+    const auto ticks = getTicksUntilTarget(tmID);
+
+    i64 cyclesUntilTarget;
+
+    if (isHBLANKClock(tmID)) {
+        cyclesUntilTarget = gpu::getHBLANKTime(gpu::getHBLANKCount(timer.lastSync) + ticks) - timer.lastSync;
+    } else {
+        cyclesUntilTarget = ticks * timer.prescaler + 1 - timer.subcount;
+    }
+
+    scheduler::addEvent(idIRQ[tmID], tmID, cyclesUntilTarget);
+}
+
+/* Handles timer compare/overflow events */
+void irqEvent(int tmID) {
+    sync(tmID);
+    schedule(tmID);
+}
+
 void init() {
     memset(&timers, 0, 3 * sizeof(Timer));
 
     for (auto &i : timers) i.prescaler = 1;
 
+    for (auto &id : idIRQ) id = scheduler::registerEvent([](int tmID, i64) { irqEvent(tmID); });
+
     std::printf("[Timer     ] Init OK\n");
 }
 
@@ -95,6 +220,8 @@ u16 read(u32 addr) {
 
     auto &timer = timers[chn];
 
+    sync(chn);
+
     switch ((addr & ~0xFF0) | (1 << 8)) {
         case TimerReg::COUNT:
             //std::printf("[Timer     ] 16-bit read @ T%d_COUNT\n", chn);
@@ -141,6 +268,8 @@ void write(u32 addr, u16 data) {
 
     auto &timer = timers[chn];
 
+    sync(chn);
+
     switch ((addr & ~0xFF0) | (1 << 8)) {
         case TimerReg::COUNT:
             std::printf("[Timer     ] 16-bit write @ T%d_COUNT = 0x%04X\n", chn, data);
@@ -223,82 +352,8 @@ void write(u32 addr, u16 data) {
 
             exit(0);
     }
-}
-
-/* Steps timers */
-void step(i64 c) {
-    for (int i = 0; i < 3; i++) {
-        auto &timer = timers[i];
-
-        /* Timers 0 and 1 have a different clock source if CLKS is odd */
-        if ((timer.mode.clks & 1) && ((i == 0) || (i == 1))) continue;
 
-        if (timer.isPaused) continue;
-
-        timer.subcount += c;
-
-        while (timer.subcount > timer.prescaler) {
-            timer.count++;
-
-            if (timer.count & (1 << 16)) {
-                if (timer.mode.ovfe && !timer.mode.ovff) {
-                    // Checking OVFF is necessary because timer IRQs are edge-triggered
-                    timer.mode.ovff = true;
-
-                    sendInterrupt(i);
-                }
-            }
-
-            timer.count &= 0xFFFF;
-
-            if (timer.count == timer.comp) {
-                if (timer.mode.cmpe && !timer.mode.equf) {
-                    // Checking EQUF is necessary because timer IRQs are edge-triggered
-                    timer.mode.equf = true;
-
-                    sendInterrupt(i);
-                }
-
-                if (timer.mode.zret) timer.count = 0;
-            }
-
-            timer.subcount -= timer.prescaler;
-        }
-    }
-}
-
-/* Steps HBLANK timer */
-void stepHBLANK() {
-    auto &timer = timers[1];
-
-    /* Not in HBLANK mode */
-    if (!(timer.mode.clks & 1)) return;
-
-    if (timer.isPaused) return;
-
-    timer.count++;
-
-    if (timer.count & (1 << 16)) {
-        if (timer.mode.ovfe && !timer.mode.ovff) {
-            // Checking OVFF is necessary because timer IRQs are edge-triggered
-            timer.mode.ovff = true;
-
-            sendInterrupt(1);
-        }
-    }
-
-    timer.count &= 0xFFFF;
-
-    if (timer.count == timer.comp) {
-        if (timer.mode.cmpe && !timer.mode.equf) {
-            // Checking EQUF is necessary because timer IRQs are edge-triggered
-            timer.mode.equf = true;
-
-            sendInterrupt(1);
-        }
-
-        if (timer.mode.zret) timer.count = 0;
-    }
+    schedule(chn);
 }
 
 /* Handle VBLANK start gate events */
@@ -309,6 +364,8 @@ void gateVBLANKStart() {
 
     if (!mode.gate) return;
 
+    sync(1);
+
     switch (mode.gats) {
         case 0: // Pause during VBLANK
             timer.isPaused = true;
@@ -325,6 +382,8 @@ void gateVBLANKStart() {
             timer.isPaused = false;
             break;
     }
+
+    schedule(1);
 }
 
 /* Handle VBLANK end gate events */
@@ -335,6 +394,8 @@ void gateVBLANKEnd() {
 
     if (!mode.gate) return;
 
+    sync(1);
+
     switch (mode.gats) {
         case 0: // Pause during VBLANK
             timer.isPaused = false;
@@ -345,6 +406,8 @@ void gateVBLANKEnd() {
             break;
         case 3: break; // Pause ONCE until VBLANK start
     }
+
+    schedule(1);
 }
 
 }
@@ -15,9 +15,6 @@ u16 read(u32 addr);
 
 void write(u32 addr, u16 data);
 
-void step(i64 c);
-void stepHBLANK();
-
 void gateVBLANKStart();
 void gateVBLANKEnd();
 
@@ -0,0 +1,210 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#include "tracer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "scheduler.hpp"
+
+namespace ps::tracer {
+
+using Clock = std::chrono::steady_clock;
+
+/* --- Tracer constants --- */
+
+constexpr size_t RING_SIZE = 1 << 16; // Records per thread, must be a power of 2
+
+constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds(10);
+
+/* Single producer, single consumer ring buffer. One per recording thread */
+struct Ring {
+    Record records[RING_SIZE];
+
+    std::atomic<size_t> head{0}, tail{0}; // Written by producer/consumer, respectively
+
+    std::atomic<u64> dropped{0};
+
+    u32 tid;
+};
+
+bool enabled = false;
+
+std::FILE *file = NULL;
+
+Clock::time_point startTime;
+
+/* Rings are only added (under lock) and never freed while the tracer is active */
+std::mutex ringMutex;
+std::vector<std::unique_ptr<Ring>> rings;
+
+thread_local Ring *localRing = NULL;
+
+/* Background writer */
+std::thread writer;
+std::mutex writerMutex;
+std::condition_variable writerCV;
+
+bool isWriterRunning = false;
+
+/* Returns host time since tracer initialization */
+u64 getTime() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime).count();
+}
+
+/* Creates and registers a ring for the calling thread */
+Ring *getRing() {
+    std::lock_guard<std::mutex> lock(ringMutex);
+
+    auto ring = std::make_unique<Ring>();
+
+    ring->tid = (u32)rings.size() + 1;
+
+    if (file) std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Emulator thread %u\"}}", ring->tid, ring->tid);
+
+    rings.push_back(std::move(ring));
+
+    return rings.back().get();
+}
+
+void record(Phase phase, const char *cat, const char *name, u32 id, const char *argName, i64 arg, u64 ts, u64 dur) {
+    if (!localRing) localRing = getRing();
+
+    auto &r = *localRing;
+
+    const auto head = r.head.load(std::memory_order_relaxed);
+
+    if ((head - r.tail.load(std::memory_order_acquire)) == RING_SIZE) {
+        // Writer can't keep up
+        r.dropped.fetch_add(1, std::memory_order_relaxed);
+
+        return;
+    }
+
+    r.records[head & (RING_SIZE - 1)] = Record{ts, dur, scheduler::getCycleCount(), cat, name, argName, arg, id, phase};
+
+    r.head.store(head + 1, std::memory_order_release);
+}
+
+void writeRecord(const Record &r, u32 tid) {
+    std::fprintf(
+        file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":1,\"tid\":%u",
+        r.name, r.cat, static_cast<char>(r.phase), (unsigned long long)(r.ts / 1000), (unsigned long long)(r.ts % 1000), tid
+    );
+
+    switch (r.phase) {
+        case Phase::Complete:
+            std::fprintf(file, ",\"dur\":%llu.%03llu", (unsigned long long)(r.dur / 1000), (unsigned long long)(r.dur % 1000));
+            break;
+        case Phase::Instant:
+            std::fprintf(file, ",\"s\":\"t\"");
+            break;
+        case Phase::AsyncBegin:
+        case Phase::AsyncEnd:
+            std::fprintf(file, ",\"id\":%u", r.id);
+            break;
+        default:
+            break;
+    }
+
+    std::fprintf(file, ",\"args\":{\"cycle\":%lld", (long long)r.cycle);
+
+    if (r.argName) std::fprintf(file, ",\"%s\":%lld", r.argName, (long long)r.arg);
+
+    std::fprintf(file, "}}");
+}
+
+/* Writes all pending records to the trace file */
+void drain() {
+    std::lock_guard<std::mutex> lock(ringMutex);
+
+    for (auto &ring : rings) {
+        auto &r = *ring;
+
+        const auto head = r.head.load(std::memory_order_acquire);
+
+        auto tail = r.tail.load(std::memory_order_relaxed);
+
+        for (; tail != head; tail++) writeRecord(r.records[tail & (RING_SIZE - 1)], r.tid);
+
+        r.tail.store(tail, std::memory_order_release);
+    }
+}
+
+void writerThread() {
+    std::unique_lock<std::mutex> lock(writerMutex);
+
+    while (isWriterRunning) {
+        writerCV.wait_for(lock, FLUSH_INTERVAL);
+
+        drain();
+    }
+}
+
+void close() {
+    if (!file) return;
+
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+
+        isWriterRunning = false;
+    }
+
+    writerCV.notify_one();
+
+    writer.join();
+
+    enabled = false;
+
+    drain();
+
+    u64 dropped = 0;
+
+    for (auto &ring : rings) dropped += ring->dropped.load();
+
+    if (dropped) std::printf("[Tracer    ] Dropped %llu records\n", (unsigned long long)dropped);
+
+    std::fprintf(file, "\n]}\n");
+    std::fclose(file);
+
+    file = NULL;
+}
+
+void init(const char *path) {
+    if (!path) return;
+
+    file = std::fopen(path, "w");
+
+    if (!file) {
+        std::printf("[Tracer    ] Unable to open file \"%s\"\n", path);
+
+        exit(0);
+    }
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Mari\"}}");
+
+    startTime = Clock::now();
+
+    isWriterRunning = true;
+
+    writer = std::thread(writerThread);
+
+    std::atexit(close);
+
+    enabled = true;
+
+    std::printf("[Tracer    ] Writing Chrome trace to \"%s\"\n", path);
+}
+
+}
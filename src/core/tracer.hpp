@@ -0,0 +1,89 @@
+/*
+ * Mari is a PlayStation emulator.
+ * Copyright (C) 2023  Lady Starbreeze (Michelle-Marie Schiller)
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "../common/types.hpp"
+
+namespace ps::tracer {
+
+/* Chrome trace event phases */
+enum class Phase : char {
+    Begin      = 'B',
+    End        = 'E',
+    Complete   = 'X',
+    Instant    = 'i',
+    AsyncBegin = 'b',
+    AsyncEnd   = 'e',
+};
+
+/* Trace record, names must be string literals (or otherwise outlive the tracer) */
+struct Record {
+    u64 ts;  // Host time (ns)
+    u64 dur; // Complete events only
+    i64 cycle;
+
+    const char *cat;
+    const char *name;
+    const char *argName; // NULL if no argument
+
+    i64 arg;
+    u32 id; // Async events only
+
+    Phase phase;
+};
+
+extern bool enabled;
+
+void init(const char *path);
+
+u64 getTime();
+
+void record(Phase phase, const char *cat, const char *name, u32 id, const char *argName, i64 arg, u64 ts, u64 dur);
+
+inline void begin(const char *cat, const char *name, const char *argName = NULL, i64 arg = 0) {
+    if (enabled) record(Phase::Begin, cat, name, 0, argName, arg, getTime(), 0);
+}
+
+inline void end(const char *cat, const char *name) {
+    if (enabled) record(Phase::End, cat, name, 0, NULL, 0, getTime(), 0);
+}
+
+inline void instant(const char *cat, const char *name, const char *argName = NULL, i64 arg = 0) {
+    if (enabled) record(Phase::Instant, cat, name, 0, argName, arg, getTime(), 0);
+}
+
+/* Async spans may overlap other spans, they are matched by category, name and ID */
+inline void asyncBegin(const char *cat, const char *name, u32 id, const char *argName = NULL, i64 arg = 0) {
+    if (enabled) record(Phase::AsyncBegin, cat, name, id, argName, arg, getTime(), 0);
+}
+
+inline void asyncEnd(const char *cat, const char *name, u32 id) {
+    if (enabled) record(Phase::AsyncEnd, cat, name, id, NULL, 0, getTime(), 0);
+}
+
+/* Scoped span, recorded as a single complete event */
+struct Scope {
+    Scope(const char *cat, const char *name, const char *argName = NULL, i64 arg = 0) : cat(cat), name(name), argName(argName), arg(arg) {
+        if (enabled) start = getTime();
+    }
+
+    ~Scope() {
+        if (enabled) {
+            const auto now = getTime();
+
+            record(Phase::Complete, cat, name, 0, argName, arg, start, now - start);
+        }
+    }
+
+    const char *cat, *name, *argName;
+
+    i64 arg;
+    u64 start = 0;
+};
+
+}
@@ -4,19 +4,131 @@
  */
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "core/Mari.hpp"
 
+void printUsage() {
+    std::printf("Usage: Mari [options] /path/to/bios /path/to/iso [/path/to/exe]\n");
+    std::printf("Options:\n");
+    std::printf("  --profile <file>    Write per-frame subsystem profile (JSON lines)\n");
+    std::printf("  --trace <file>      Write Chrome/Perfetto event trace (JSON)\n");
+    std::printf("  --hotspots <file>   Write hottest guest functions and loops on exit\n");
+    std::printf("  --symbols <file>    Guest symbol map (\"ADDRESS NAME\" per line) for --hotspots\n");
+    std::printf("  --frames <n>        Benchmark mode: run n frames without video output, print statistics\n");
+    std::printf("  --hash <f1,f2,...>  Print VRAM hashes at these frames (default in benchmark mode: last frame)\n");
+    std::printf("  --input <file>      Input script (\"FRAME BUTTONS\" per line, buttons in hex)\n");
+    std::printf("  --record <file>     Record input movie\n");
+    std::printf("  --play <file>       Play back input movie\n");
+    std::printf("  --speed <s>         Emulation speed: ntsc (default), pal, <n>x (n times NTSC), max (unthrottled)\n");
+    std::printf("  --skip <n>          Skip presenting up to n consecutive frames when faster than 60 fps\n");
+    std::printf("  --cpu <core>        CPU interpreter: switch (default), threaded (computed goto), ir (block recompiler)\n");
+    std::printf("  --tcache <file>     Persistent translation cache for --cpu ir (loaded at startup, updated on exit)\n");
+    std::printf("  --simd <level>      Highest SIMD level to use (scalar, sse4.1, avx2, avx512)\n");
+    std::printf("  --break <addr>      Log registers when the instruction at addr is fetched (repeatable)\n");
+    std::printf("  --watch <addr>      Log writes to addr (repeatable)\n");
+    std::printf("  --rwatch <addr>     Log reads from addr (repeatable)\n");
+}
+
 int main(int argc, char **argv) {
     std::printf("[Mari      ] PlayStation emulator\n");
 
-    if (argc < 3) {
-        std::printf("Usage: Mari /path/to/bios /path/to/iso\n");
+    ps::Config config;
+
+    const char *paths[3] = {NULL, NULL, NULL};
+    int pathCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+
+        if (std::strncmp(arg, "--", 2) != 0) {
+            if (pathCount == 3) {
+                printUsage();
+
+                return -1;
+            }
+
+            paths[pathCount++] = arg;
+
+            continue;
+        }
+
+        /* All options take exactly one argument */
+        if ((i + 1) == argc) {
+            printUsage();
+
+            return -1;
+        }
+
+        const char *val = argv[++i];
+
+        if (!std::strcmp(arg, "--profile")) {
+            config.profilePath = val;
+        } else if (!std::strcmp(arg, "--trace")) {
+            config.tracePath = val;
+        } else if (!std::strcmp(arg, "--hotspots")) {
+            config.hotspotPath = val;
+        } else if (!std::strcmp(arg, "--symbols")) {
+            config.symbolPath = val;
+        } else if (!std::strcmp(arg, "--frames")) {
+            config.benchFrames = std::strtoull(val, NULL, 0);
+        } else if (!std::strcmp(arg, "--hash")) {
+            for (const char *s = val; *s;) {
+                char *end;
+
+                config.hashFrames.push_back(std::strtoull(s, &end, 0));
+
+                if ((end == s) || ((*end != ',') && (*end != '\0'))) {
+                    printUsage();
+
+                    return -1;
+                }
+
+                s = (*end == ',') ? end + 1 : end;
+            }
+        } else if (!std::strcmp(arg, "--input")) {
+            config.inputPath = val;
+        } else if (!std::strcmp(arg, "--record")) {
+            config.movieRecordPath = val;
+        } else if (!std::strcmp(arg, "--play")) {
+            config.moviePlayPath = val;
+        } else if (!std::strcmp(arg, "--speed")) {
+            config.speed = val;
+        } else if (!std::strcmp(arg, "--skip")) {
+            config.maxFrameSkip = std::atoi(val);
+        } else if (!std::strcmp(arg, "--cpu")) {
+            config.cpuCore = val;
+        } else if (!std::strcmp(arg, "--tcache")) {
+            config.tcachePath = val;
+        } else if (!std::strcmp(arg, "--simd")) {
+            config.simdLevel = val;
+        } else if (!std::strcmp(arg, "--break")) {
+            config.breakpoints.push_back(std::strtoul(val, NULL, 0));
+        } else if (!std::strcmp(arg, "--watch")) {
+            config.writeWatchpoints.push_back(std::strtoul(val, NULL, 0));
+        } else if (!std::strcmp(arg, "--rwatch")) {
+            config.readWatchpoints.push_back(std::strtoul(val, NULL, 0));
+        } else {
+            std::printf("Unknown option \"%s\"\n", arg);
+
+            printUsage();
+
+            return -1;
+        }
+    }
+
+    if (pathCount < 2) {
+        printUsage();
 
         return -1;
     }
 
-    ps::init(argv[1], argv[2], (argc == 4) ? argv[3] : NULL);
+    config.biosPath = paths[0];
+    config.isoPath  = paths[1];
+    config.exePath  = paths[2];
+
+    ps::init(config);
     ps::run();
 
     return 0;